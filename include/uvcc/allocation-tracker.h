@@ -0,0 +1,275 @@
+/// MIT License
+///
+/// uvcc/allocation-tracker.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+#include <uv.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace uvcc {
+
+/// Allocation counters by subsystem. `install()` routes libuv's own
+/// allocations through a counting allocator and must run before any other
+/// libuv call. uvcc's handle and request storage, buffers and callback
+/// tables are counted when built with `UVCC_TRACK_ALLOCATIONS`; otherwise
+/// they go straight to `malloc`. Counters belong to the thread that
+/// allocated, which for a loop is the thread it runs on.
+class AllocationTracker {
+ public:
+  enum class Subsystem : int {
+    kLibuv = 0,
+    kHandles,
+    kRequests,
+    kBuffers,
+    kCallbacks,
+    kOther,
+  };
+
+  static const int kSubsystemCount = 6;
+
+  struct Counters {
+    std::uint64_t allocations = 0;
+    std::int64_t live_bytes = 0;
+    std::int64_t peak_bytes = 0;
+  };
+
+  class Stats {
+    friend class AllocationTracker;
+
+   public:
+    Counters counters(Subsystem subsystem) const _NOEXCEPT {
+      auto i = static_cast<int>(subsystem);
+      Counters counters;
+      counters.allocations = allocations_[i].load(std::memory_order_relaxed);
+      counters.live_bytes = live_bytes_[i].load(std::memory_order_relaxed);
+      counters.peak_bytes = peak_bytes_[i].load(std::memory_order_relaxed);
+      return counters;
+    }
+
+    /// Sums every subsystem; the peak is the sum of per-subsystem peaks.
+    Counters total() const _NOEXCEPT {
+      Counters total;
+      for (int i = 0; i < kSubsystemCount; ++i) {
+        auto counters = this->counters(static_cast<Subsystem>(i));
+        total.allocations += counters.allocations;
+        total.live_bytes += counters.live_bytes;
+        total.peak_bytes += counters.peak_bytes;
+      }
+      return total;
+    }
+
+    /// Allocations per second since the previous call.
+    double allocationRate() const _NOEXCEPT {
+      auto now = uv_hrtime();
+      auto allocations = total().allocations;
+      auto elapsed = now - sampled_at_;
+      auto rate = elapsed ? (allocations - sampled_allocations_) * 1e9 / elapsed
+                          : 0.0;
+      sampled_at_ = now;
+      sampled_allocations_ = allocations;
+      return rate;
+    }
+
+   private:
+    std::atomic<std::uint64_t> allocations_[kSubsystemCount] = {};
+    std::atomic<std::int64_t> live_bytes_[kSubsystemCount] = {};
+    std::atomic<std::int64_t> peak_bytes_[kSubsystemCount] = {};
+    mutable std::uint64_t sampled_at_ = uv_hrtime();
+    mutable std::uint64_t sampled_allocations_ = 0;
+    Stats *next_ = nullptr;
+  };
+
+  /// Storage deleter for objects made by `create()`.
+  template <typename T>
+  struct Deleter {
+    void operator()(T *object) const _NOEXCEPT {
+      object->~T();
+      AllocationTracker::deallocate(object);
+    }
+  };
+
+  /// Base that sends `new` and `delete` of the derived type to `allocate()`.
+  template <Subsystem subsystem>
+  struct Tagged {
+    static void *operator new(std::size_t size) {
+      return AllocationTracker::allocate(subsystem, size);
+    }
+    static void operator delete(void *pointer) _NOEXCEPT {
+      AllocationTracker::deallocate(pointer);
+    }
+  };
+
+  static bool install() _NOEXCEPT {
+    if (installed()) return true;
+    if (uv_replace_allocator(&AllocationTracker::_malloc,
+                             &AllocationTracker::_realloc,
+                             &AllocationTracker::_calloc,
+                             &AllocationTracker::_free))
+      return false;
+    installed() = true;
+    return true;
+  }
+
+  static bool isInstalled() _NOEXCEPT { return installed(); }
+
+  /// Counters of the calling thread.
+  static Stats &current() _NOEXCEPT {
+    // Never freed: memory may be released after its thread has exited.
+    // Listed so that the counters of exited threads stay reachable.
+    static thread_local Stats *stats = _list(new Stats());
+    return *stats;
+  }
+
+  static void *allocate(Subsystem subsystem, std::size_t size) {
+#ifdef UVCC_TRACK_ALLOCATIONS
+    auto pointer = _allocate(subsystem, size);
+#else
+    (void)subsystem;
+    auto pointer = std::malloc(size ? size : 1);
+#endif
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+  }
+
+  static void deallocate(void *pointer) _NOEXCEPT {
+#ifdef UVCC_TRACK_ALLOCATIONS
+    _deallocate(pointer);
+#else
+    std::free(pointer);
+#endif
+  }
+
+  template <typename T, typename... Ts>
+  static T *create(Subsystem subsystem, Ts &&...params) {
+    auto storage = allocate(subsystem, sizeof(T));
+    try {
+      return new (storage) T(std::forward<Ts>(params)...);
+    } catch (...) {
+      deallocate(storage);
+      throw;
+    }
+  }
+
+ private:
+  struct alignas(16) Header {
+    Stats *owner;
+    std::size_t size;
+    Subsystem subsystem;
+  };
+
+  static Stats *_list(Stats *stats) _NOEXCEPT {
+    static std::atomic<Stats *> head(nullptr);
+    stats->next_ = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(stats->next_, stats,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+    return stats;
+  }
+
+  static bool &installed() _NOEXCEPT {
+    static bool installed = false;
+    return installed;
+  }
+
+  static void _count(Stats &stats, Subsystem subsystem, std::int64_t bytes,
+                     bool allocation) _NOEXCEPT {
+    auto i = static_cast<int>(subsystem);
+    if (allocation)
+      stats.allocations_[i].fetch_add(1, std::memory_order_relaxed);
+    auto live =
+        stats.live_bytes_[i].fetch_add(bytes, std::memory_order_relaxed) +
+        bytes;
+    // Frees and reallocations from other threads update the owner's
+    // counters too, so a plain store could lower a concurrent peak.
+    auto peak = stats.peak_bytes_[i].load(std::memory_order_relaxed);
+    while (live > peak &&
+           !stats.peak_bytes_[i].compare_exchange_weak(
+               peak, live, std::memory_order_relaxed)) {
+    }
+  }
+
+  static void *_allocate(Subsystem subsystem, std::size_t size) _NOEXCEPT {
+    auto header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+    if (!header) return nullptr;
+    header->owner = &current();
+    header->size = size;
+    header->subsystem = subsystem;
+    _count(*header->owner, subsystem, static_cast<std::int64_t>(size), true);
+    return header + 1;
+  }
+
+  static void _deallocate(void *pointer) _NOEXCEPT {
+    if (!pointer) return;
+    auto header = static_cast<Header *>(pointer) - 1;
+    _count(*header->owner, header->subsystem,
+           -static_cast<std::int64_t>(header->size), false);
+    std::free(header);
+  }
+
+  static void *_malloc(std::size_t size) {
+    return _allocate(Subsystem::kLibuv, size);
+  }
+
+  static void *_realloc(void *pointer, std::size_t size) {
+    if (!pointer) return _malloc(size);
+    if (!size) {
+      _deallocate(pointer);
+      return nullptr;
+    }
+    auto header = static_cast<Header *>(pointer) - 1;
+    auto owner = header->owner;
+    auto old_size = header->size;
+    auto moved =
+        static_cast<Header *>(std::realloc(header, sizeof(Header) + size));
+    if (!moved) return nullptr;
+    moved->size = size;
+    _count(*owner, Subsystem::kLibuv,
+           static_cast<std::int64_t>(size) - static_cast<std::int64_t>(old_size),
+           true);
+    return moved + 1;
+  }
+
+  static void *_calloc(std::size_t count, std::size_t size) {
+    if (size && count > static_cast<std::size_t>(-1) / size) return nullptr;
+    auto pointer = _malloc(count * size);
+    if (pointer) std::memset(pointer, 0, count * size);
+    return pointer;
+  }
+
+  static void _free(void *pointer) { _deallocate(pointer); }
+};
+
+}  // namespace uvcc
+
+#endif  // ALLOCATIONTRACKER_H
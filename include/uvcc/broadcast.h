@@ -0,0 +1,221 @@
+/// MIT License
+///
+/// uvcc/broadcast.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <uv.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include "pool.h"
+#include "stream.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Reference-counted byte buffer shared by many in-flight writes. The count
+/// is not atomic: a buffer belongs to the loop thread that created it.
+class SharedBuffer {
+ public:
+  SharedBuffer(const SharedBuffer &) = delete;
+  SharedBuffer &operator=(const SharedBuffer &) = delete;
+
+  static SharedBuffer *make(std::size_t size) {
+    auto storage = AllocationTracker::allocate(
+        AllocationTracker::Subsystem::kBuffers, sizeof(SharedBuffer) + size);
+    return new (storage) SharedBuffer(size);
+  }
+
+  static SharedBuffer *copy(const void *data, std::size_t size) {
+    auto buffer = make(size);
+    std::memcpy(buffer->data(), data, size);
+    return buffer;
+  }
+
+  char *data() _NOEXCEPT { return reinterpret_cast<char *>(this + 1); }
+
+  std::size_t size() const _NOEXCEPT { return size_; }
+
+  std::size_t useCount() const _NOEXCEPT { return references_; }
+
+  SharedBuffer *retain() _NOEXCEPT {
+    ++references_;
+    return this;
+  }
+
+  void release() _NOEXCEPT {
+    if (--references_ == 0) {
+      this->~SharedBuffer();
+      AllocationTracker::deallocate(this);
+    }
+  }
+
+ private:
+  std::size_t references_ = 1;
+  std::size_t size_;
+
+  explicit SharedBuffer(std::size_t size) _NOEXCEPT : size_(size) {}
+};
+
+/// Fans one `SharedBuffer` out to many streams without copying it. Each
+/// subscriber first gets a `uv_try_write`; only what the socket does not
+/// take immediately is queued, with a pooled request that holds a reference
+/// on the payload. Subscribers whose write queue would exceed
+/// `max_queue_size` bytes are skipped and reported to `slowSubscriberHandler`.
+/// Corked, rate-limited or captured streams get an ordinary `Stream::write`
+/// instead, so the payload stays in order behind their batched and held
+/// writes. The broadcaster must outlive the writes it has queued.
+class Broadcaster {
+ public:
+  /// `failed` counts writes that could not be issued; queued writes from
+  /// earlier sends that have since completed with an error are in
+  /// `failed_earlier`.
+  struct Report {
+    std::size_t sent = 0;
+    std::size_t queued = 0;
+    std::size_t skipped = 0;
+    std::size_t failed = 0;
+    std::size_t failed_earlier = 0;
+  };
+
+  explicit Broadcaster(std::size_t max_queue_size = 1 << 20) _NOEXCEPT
+      : max_queue_size_(max_queue_size) {}
+  Broadcaster(const Broadcaster &) = delete;
+  Broadcaster &operator=(const Broadcaster &) = delete;
+  ~Broadcaster() = default;
+
+  /// Sends `payload` to every stream; the caller keeps its own reference.
+  Report send(SharedBuffer *payload, const std::vector<uvcc::Stream *> &streams) {
+    Report report;
+    report.failed_earlier = failed_;
+    failed_ = 0;
+    for (auto stream : streams) _send(payload, *stream, report);
+    return report;
+  }
+
+  std::size_t inflightCount() const _NOEXCEPT { return inflight_; }
+
+  std::size_t maxQueueSize() const _NOEXCEPT { return max_queue_size_; }
+
+  void setMaxQueueSize(std::size_t size) _NOEXCEPT { max_queue_size_ = size; }
+
+  std::function<void(uvcc::Stream &)> slowSubscriberHandler;
+
+ private:
+  struct Write {
+    uv_write_t request;
+    Broadcaster *broadcaster;
+    SharedBuffer *payload;
+  };
+
+  uvcc::ObjectPool<Write> writes_;
+  std::size_t max_queue_size_;
+  std::size_t inflight_ = 0;
+  std::size_t failed_ = 0;
+
+  void _send(SharedBuffer *payload, uvcc::Stream &stream, Report &report) {
+    auto handle = stream._someStream();
+    auto queue_size = stream.writeQueueSize();
+    if (!uv_is_writable(handle)) {
+      ++report.failed;
+      return;
+    }
+    if (queue_size + payload->size() > max_queue_size_) {
+      ++report.skipped;
+      if (slowSubscriberHandler) slowSubscriberHandler(stream);
+      return;
+    }
+    auto buf = uv_buf_init(payload->data(),
+                           static_cast<unsigned int>(payload->size()));
+    auto &callbacks = *stream.callbacks_;
+    if (stream.isCorked() || callbacks.write_limit ||
+        callbacks.shared_write_limit || callbacks.capture)
+      return _write(payload, stream, buf, report);
+    if (queue_size == 0) {
+      auto written = uv_try_write(handle, &buf, 1);
+      if (written == static_cast<int>(buf.len)) {
+        ++report.sent;
+        return;
+      }
+      if (written < 0 && written != UV_EAGAIN) {
+        ++report.failed;
+        return;
+      }
+      if (written > 0) {
+        buf.base += written;
+        buf.len -= written;
+      }
+    }
+    auto write = writes_.acquire();
+    write->broadcaster = this;
+    write->payload = payload->retain();
+    auto err = uv_write(&write->request, handle, &buf, 1,
+                        [](uv_write_t *request, int status) {
+                          auto write = reinterpret_cast<Write *>(request);
+                          auto broadcaster = write->broadcaster;
+                          if (status) ++broadcaster->failed_;
+                          write->payload->release();
+                          --broadcaster->inflight_;
+                          broadcaster->writes_.release(write);
+                        });
+    if (err) {
+      payload->release();
+      writes_.release(write);
+      ++report.failed;
+      return;
+    }
+    ++inflight_;
+    ++report.queued;
+  }
+
+  void _write(SharedBuffer *payload, uvcc::Stream &stream, const uv_buf_t &buf,
+              Report &report) {
+    payload->retain();
+    try {
+      stream.write(buf, [this, payload](uv_write_t *, int status) {
+        if (status) ++failed_;
+        payload->release();
+        --inflight_;
+      });
+    } catch (const uvcc::Exception &) {
+      payload->release();
+      ++report.failed;
+      return;
+    }
+    ++inflight_;
+    ++report.queued;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // BROADCAST_H
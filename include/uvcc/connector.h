@@ -0,0 +1,224 @@
+/// MIT License
+///
+/// uvcc/connector.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <uv.h>
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "event-loop.h"
+#include "stream.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+namespace network {
+
+/// Connects to the first reachable address of a resolved list, racing
+/// attempts as RFC 8305 describes: families are interleaved starting with
+/// the list's first, a new attempt starts every `attempt_delay`
+/// milliseconds or as soon as one fails, and the first to connect wins
+/// while the rest are closed.
+class Connector {
+ public:
+  using ConnectingCompletionBlock =
+      std::function<void(int, std::shared_ptr<uvcc::Stream>)>;
+
+  struct Options {
+    std::uint64_t attempt_delay = 250;
+    /// Addresses of the first family tried before alternating.
+    std::size_t first_family_count = 1;
+    /// Gives up with `UV_ETIMEDOUT` after this many milliseconds; 0 waits
+    /// for every attempt to finish.
+    std::uint64_t timeout = 0;
+  };
+
+  Connector(uvcc::EventLoop &loop, const addrinfo *addresses)
+      : Connector(loop, addresses, Options()) {}
+  Connector(uvcc::EventLoop &loop, const addrinfo *addresses,
+            const Options &options)
+      : context_(std::make_shared<Context>()) {
+    context_->loop = &loop;
+    context_->options = options;
+    for (auto p = addresses; p; p = p->ai_next) {
+      if (p->ai_family != AF_INET && p->ai_family != AF_INET6) continue;
+      sockaddr_storage address;
+      std::memset(&address, 0, sizeof(address));
+      std::memcpy(&address, p->ai_addr, p->ai_addrlen);
+      context_->addresses.push_back(address);
+    }
+  }
+  Connector(uvcc::EventLoop &loop, const std::vector<sockaddr_storage> &addresses,
+            const Options &options)
+      : context_(std::make_shared<Context>()) {
+    context_->loop = &loop;
+    context_->options = options;
+    context_->addresses = addresses;
+  }
+  Connector(const Connector &) = delete;
+  Connector &operator=(const Connector &) = delete;
+  ~Connector() { cancel(); }
+
+  /// Calls `block` once with the connected stream, or with the last
+  /// attempt's error and null when none connects.
+  void start(ConnectingCompletionBlock &&block) {
+    if (context_->started) uvcc::expr_throws(UV_EALREADY);
+    context_->started = true;
+    context_->block = std::move(block);
+    _interleave(*context_);
+    if (context_->options.timeout) {
+      std::weak_ptr<Context> weak = context_;
+      context_->loop->throttle().defer(
+          &context_->options, context_->options.timeout, [weak] {
+            if (auto context = weak.lock()) _finish(context, UV_ETIMEDOUT);
+          });
+    }
+    _attempt(context_);
+  }
+
+  /// Abandons every attempt without calling the completion block.
+  void cancel() _NOEXCEPT {
+    if (!context_->started || context_->done) return;
+    context_->block = nullptr;
+    _stop(*context_);
+  }
+
+  std::size_t attemptCount() const _NOEXCEPT { return context_->next; }
+
+  bool isDone() const _NOEXCEPT { return context_->done; }
+
+ private:
+  struct Context {
+    uvcc::EventLoop *loop;
+    Options options;
+    std::vector<sockaddr_storage> addresses;
+    std::vector<std::shared_ptr<uvcc::Stream>> attempts;
+    std::size_t next = 0;
+    std::size_t running = 0;
+    int error = UV_EADDRNOTAVAIL;
+    bool started = false;
+    bool done = false;
+    ConnectingCompletionBlock block;
+  };
+
+  std::shared_ptr<Context> context_;
+
+  /// Orders the addresses by alternating families, keeping each family's
+  /// own order.
+  static void _interleave(Context &context) {
+    auto &addresses = context.addresses;
+    if (addresses.empty()) return;
+    auto first = addresses.front().ss_family;
+    std::vector<sockaddr_storage> primary, secondary, ordered;
+    for (auto &address : addresses)
+      (address.ss_family == first ? primary : secondary).push_back(address);
+    std::size_t i = 0, j = 0;
+    auto count = std::max<std::size_t>(context.options.first_family_count, 1);
+    for (; i < primary.size() && i < count; ++i)
+      ordered.push_back(primary[i]);
+    while (i < primary.size() || j < secondary.size()) {
+      if (j < secondary.size()) ordered.push_back(secondary[j++]);
+      if (i < primary.size()) ordered.push_back(primary[i++]);
+    }
+    addresses.swap(ordered);
+    context.attempts.resize(addresses.size());
+  }
+
+  /// Starts the next address, and arms the delay before the one after.
+  static void _attempt(const std::shared_ptr<Context> &context) {
+    while (!context->done && context->next < context->addresses.size()) {
+      auto index = context->next++;
+      auto stream =
+          std::make_shared<uvcc::Stream>(uvcc::Stream::TransmitType::kTCP);
+      try {
+        stream->open(*context->loop);
+        context->attempts[index] = stream;
+        stream->connect(
+            reinterpret_cast<const sockaddr *>(&context->addresses[index]),
+            [context, index](uv_connect_t *, int status) {
+              _complete(context, index, status);
+            });
+      } catch (const uvcc::Exception &exception) {
+        context->attempts[index].reset();
+        context->error = exception.rawCode();
+        continue;
+      }
+      ++context->running;
+      if (context->next < context->addresses.size()) {
+        std::weak_ptr<Context> weak = context;
+        context->loop->throttle().defer(
+            context.get(), context->options.attempt_delay, [weak] {
+              if (auto context = weak.lock()) _attempt(context);
+            });
+      }
+      return;
+    }
+    if (!context->done && !context->running) _finish(context, context->error);
+  }
+
+  static void _complete(const std::shared_ptr<Context> &context,
+                        std::size_t index, int status) {
+    if (context->done) return;
+    --context->running;
+    if (!status) {
+      auto stream = context->attempts[index];
+      context->attempts[index].reset();
+      auto block = std::move(context->block);
+      _stop(*context);
+      if (block) block(0, stream);
+      return;
+    }
+    context->error = status;
+    context->attempts[index].reset();
+    _attempt(context);
+  }
+
+  static void _finish(const std::shared_ptr<Context> &context, int status) {
+    auto block = std::move(context->block);
+    _stop(*context);
+    if (block) block(status, nullptr);
+  }
+
+  static void _stop(Context &context) _NOEXCEPT {
+    context.done = true;
+    context.loop->throttle().cancel(&context);
+    context.loop->throttle().cancel(&context.options);
+    context.attempts.clear();
+  }
+};
+
+}  // namespace network
+
+}  // namespace uvcc
+
+#endif  // CONNECTOR_H
@@ -27,18 +27,61 @@
 #ifndef EVENTLOOP_H
 #define EVENTLOOP_H
 
+#include <poll.h>
 #include <uv.h>
 
+#include <thread>
+
+#include "handle-arena.h"
+#include "loop-monitor.h"
+#include "task-scheduler.h"
+#include "token-bucket.h"
+#include "tracer.h"
 #include "utilities.h"
+#include "write-coalescer.h"
 
 namespace uvcc {
 
+namespace network {
+class Listener;
+}  // namespace network
+
 class EventLoop : virtual protected BaseObject<uv_loop_t> {
+  friend class FileCache;
+  friend class PreforkMaster;
+  friend class PreforkWorker;
+  friend class ResourceSampler;
+  friend class Runtime;
+  friend class Stream;
+  friend class Tracer;
+  friend class TrafficReplay;
+  template <typename>
+  friend class TypedHandle;
+  template <typename>
+  friend class TypedRequest;
+  friend class WorkerPools;
+  friend class network::Listener;
+
  protected:
   using MappingRawCompletionBlock = uvcc::RawCompletionBlock<uv_walk_cb>;
   using MappingCompletionBlock = std::function<MappingRawCompletionBlock>;
 
  public:
+  /// Quiet time in microseconds before `busyPoll()` first yields the CPU
+  /// between checks, then before it blocks.
+  struct BusyPollOptions {
+    std::uint64_t spin_period = 200;
+    std::uint64_t yield_period = 1000;
+  };
+
+  /// Nanoseconds spent checking for work that was not there, and blocked.
+  struct BusyPollStats {
+    std::uint64_t spinning = 0;
+    std::uint64_t sleeping = 0;
+    std::uint64_t spins = 0;
+    std::uint64_t sleeps = 0;
+  };
+
   EventLoop() : BaseObject<Self>() {
     uvcc::expr_throws(uv_loop_init(raw_.get()));
   }
@@ -48,6 +91,23 @@ class EventLoop : virtual protected BaseObject<uv_loop_t> {
   EventLoop &operator=(EventLoop &&) _NOEXCEPT = default;
   ~EventLoop() _NOEXCEPT {
     try {
+      if (tracer_) tracer_->_detach();
+      if (scheduler_ || throttle_ || monitor_) {
+        scheduler_.reset();
+        throttle_.reset();
+        monitor_.reset();
+        uv_run(raw_.get(), UV_RUN_NOWAIT);
+      }
+      if (coalescer_) {
+        coalescer_.reset();
+        uv_run(raw_.get(), UV_RUN_NOWAIT);
+      }
+      if (arena_) {
+        arena_->close();
+        uv_run(raw_.get(), UV_RUN_NOWAIT);
+        arena_.reset();
+      }
+      _drainClosing();
       _close();
     } catch (const uvcc::Exception &exception) {
       uvcc::expr_cerr(exception);
@@ -64,10 +124,49 @@ class EventLoop : virtual protected BaseObject<uv_loop_t> {
   }
 
   bool isAlive() const _NOEXCEPT {
-    return uvcc::expr_assert(uv_loop_alive(raw_.get()), true);
+    return !uvcc::expr_assert(uv_loop_alive(raw_.get()), true);
   }
 
-  void stop() _NOEXCEPT { uv_stop(raw_.get()); }
+  /// Runs like `kDefault`, but while work keeps arriving polls the backend
+  /// without blocking; after `spin_period` without any it also yields the
+  /// CPU between checks, and after `yield_period` more blocks until the next
+  /// event or timer. Any work puts it back to spinning. Returns when the
+  /// loop has nothing left or `stop()` is called.
+  void busyPoll() { busyPoll(BusyPollOptions()); }
+  void busyPoll(const BusyPollOptions &options) {
+    auto loop = raw_.get();
+    pollfd backend = {uv_backend_fd(loop), POLLIN, 0};
+    auto quiet_since = uv_hrtime();
+    stopping_ = false;
+    while (!stopping_ && uv_loop_alive(loop)) {
+      auto now = uv_hrtime();
+      uv_update_time(loop);
+      auto timeout = uv_backend_timeout(loop);
+      if (timeout != 0 && ::poll(&backend, 1, 0) <= 0) {
+        auto quiet = (now - quiet_since) / 1000;
+        if (quiet < options.spin_period + options.yield_period) {
+          if (quiet >= options.spin_period) std::this_thread::yield();
+          busy_poll_stats_.spinning += uv_hrtime() - now;
+          ++busy_poll_stats_.spins;
+          continue;
+        }
+        ::poll(&backend, 1, timeout);
+        busy_poll_stats_.sleeping += uv_hrtime() - now;
+        ++busy_poll_stats_.sleeps;
+      }
+      uv_run(loop, UV_RUN_NOWAIT);
+      quiet_since = uv_hrtime();
+    }
+  }
+
+  const BusyPollStats &busyPollStats() const _NOEXCEPT {
+    return busy_poll_stats_;
+  }
+
+  void stop() _NOEXCEPT {
+    stopping_ = true;
+    uv_stop(raw_.get());
+  }
 
   int fd() const _NOEXCEPT { return uv_backend_fd(raw_.get()); }
 
@@ -84,6 +183,60 @@ class EventLoop : virtual protected BaseObject<uv_loop_t> {
     return *this;
   }
 
+  /// Allocation counters of the thread that created this loop. Counters are
+  /// kept per thread rather than per loop, so storage allocated on libuv's
+  /// pool threads, such as the buffers `FileCache` reads files into, is
+  /// charged to those threads even when the loop frees it.
+  const uvcc::AllocationTracker::Stats &allocations() const _NOEXCEPT {
+    return *allocations_;
+  }
+
+  /// Handle storage owned by this loop, created on first use.
+  uvcc::HandleArena &arena() {
+    if (!arena_) arena_ = uvcc::make_unique<uvcc::HandleArena>(raw_.get());
+    return *arena_;
+  }
+
+  /// Flusher shared by every corked stream on this loop.
+  uvcc::WriteCoalescer &coalescer() {
+    if (!coalescer_)
+      coalescer_ =
+          uvcc::make_unique<uvcc::WriteCoalescer>(raw_.get(), tracer_);
+    return *coalescer_;
+  }
+
+  /// Budgeted runner for deferred work on this loop.
+  uvcc::TaskScheduler &scheduler() {
+    if (!scheduler_)
+      scheduler_ = uvcc::make_unique<uvcc::TaskScheduler>(raw_.get());
+    return *scheduler_;
+  }
+
+  /// Shared timer that resumes rate-limited streams on this loop.
+  uvcc::Throttle &throttle() {
+    if (!throttle_) throttle_ = uvcc::make_unique<uvcc::Throttle>(raw_.get());
+    return *throttle_;
+  }
+
+  /// Lag and idle-ratio sampling for this loop, started on first use.
+  uvcc::LoopMonitor &monitor() {
+    if (!monitor_) monitor_ = uvcc::make_unique<uvcc::LoopMonitor>(raw_.get());
+    return *monitor_;
+  }
+
+  /// Records this loop's iterations and the requests uvcc submits on it
+  /// into `tracer`, which must outlive them; null stops tracing. Configure
+  /// the loop with `LoopOption::kMetricsIDLETime` to split poll time into
+  /// waiting and I/O.
+  void setTracer(uvcc::Tracer *tracer) {
+    if (tracer_) tracer_->_detach();
+    tracer_ = tracer;
+    if (coalescer_) coalescer_->setTracer(tracer);
+    if (tracer) tracer->_attach(raw_.get());
+  }
+
+  uvcc::Tracer *tracer() const _NOEXCEPT { return tracer_; }
+
   void fork() { uvcc::expr_throws(uv_loop_fork(raw_.get())); }
 
   template <typename T>
@@ -104,6 +257,31 @@ class EventLoop : virtual protected BaseObject<uv_loop_t> {
   static std::size_t _loopSize() _NOEXCEPT { return uv_loop_size(); }
 
  private:
+  const uvcc::AllocationTracker::Stats *allocations_ =
+      &uvcc::AllocationTracker::current();
+  std::unique_ptr<uvcc::HandleArena> arena_;
+  std::unique_ptr<uvcc::WriteCoalescer> coalescer_;
+  std::unique_ptr<uvcc::TaskScheduler> scheduler_;
+  std::unique_ptr<uvcc::Throttle> throttle_;
+  std::unique_ptr<uvcc::LoopMonitor> monitor_;
+  uvcc::Tracer *tracer_ = nullptr;
+  BusyPollStats busy_poll_stats_;
+  bool stopping_ = false;
+
+  /// Lets handles whose wrappers are gone finish closing, as long as
+  /// nothing else is left to run.
+  void _drainClosing() _NOEXCEPT {
+    struct Census {
+      std::size_t open = 0;
+      std::size_t closing = 0;
+    } census;
+    uv_walk(raw_.get(), [](uv_handle_t *handle, void *arg) {
+      auto census = static_cast<Census *>(arg);
+      ++(uv_is_closing(handle) ? census->closing : census->open);
+    }, &census);
+    if (census.closing && !census.open) uv_run(raw_.get(), UV_RUN_NOWAIT);
+  }
+
   void _close() { uvcc::expr_throws(uv_loop_close(raw_.get())); }
 };
 
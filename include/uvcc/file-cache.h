@@ -0,0 +1,345 @@
+/// MIT License
+///
+/// uvcc/file-cache.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <fcntl.h>
+#include <uv.h>
+
+#include <functional>
+#include <list>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "broadcast.h"
+#include "event-loop.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Size-bounded LRU cache of whole files held in `SharedBuffer`s, so one
+/// copy can be written to any number of streams. Misses are loaded on the
+/// thread pool and concurrent misses for the same path share one load.
+/// Each cached file's directory is watched with `uv_fs_event` from before
+/// its load starts; any change reported for a file drops its entry. Paths
+/// are normalised lexically, so `a/../b` and `b` share an entry; symbolic
+/// links are not resolved.
+class FileCache {
+ public:
+  using FetchingCompletionBlock = std::function<void(SharedBuffer *, int)>;
+
+  explicit FileCache(uvcc::EventLoop &loop,
+                     std::size_t capacity = 64 * 1024 * 1024) _NOEXCEPT
+      : loop_(&loop),
+        capacity_(capacity) {}
+  FileCache(const FileCache &) = delete;
+  FileCache &operator=(const FileCache &) = delete;
+  ~FileCache() {
+    clear();
+    for (auto load : loads_) {
+      load->cache = nullptr;
+      if (load->watcher) _unwatch(load->watcher);
+      load->watcher = nullptr;
+      uv_cancel(reinterpret_cast<uv_req_t *>(&load->work));
+    }
+  }
+
+  /// Calls `block` with the file's contents, at once on a hit. The buffer is
+  /// only guaranteed to live for the call; `retain()` it to keep it.
+  void fetch(const std::string &path, FetchingCompletionBlock &&block) {
+    auto key = _normalize(path);
+    if (auto buffer = _find(key)) return block(buffer, 0);
+    ++misses_;
+    auto pending = loading_.find(key);
+    if (pending != loading_.end())
+      return pending->second->waiters.push_back(std::move(block));
+
+    auto load = new Load();
+    load->cache = this;
+    load->path = key;
+    load->watcher = _watch(_directory(key));
+    load->waiters.push_back(std::move(block));
+    load->work.data = load;
+    load->tracer = loop_->tracer_;
+    if (load->tracer) load->tracer->requestSubmitted(&load->work, UV_WORK);
+    auto err = uv_queue_work(loop_->raw_.get(), &load->work,
+                             &FileCache::_read, &FileCache::_loaded);
+    if (err) {
+      if (load->tracer) load->tracer->requestCompleted(&load->work, UV_WORK);
+      if (load->watcher) _unwatch(load->watcher);
+      auto waiters = std::move(load->waiters);
+      delete load;
+      for (auto &waiter : waiters) waiter(nullptr, err);
+      return;
+    }
+    loads_.insert(load);
+    loading_.emplace(key, load);
+  }
+
+  /// Cached contents of `path` or null; the buffer is not retained.
+  SharedBuffer *find(const std::string &path) { return _find(_normalize(path)); }
+
+  void invalidate(const std::string &path) { _invalidate(_normalize(path)); }
+
+  void clear() _NOEXCEPT {
+    while (!lru_.empty()) _invalidate(lru_.back());
+  }
+
+  std::size_t size() const _NOEXCEPT { return size_; }
+
+  std::size_t capacity() const _NOEXCEPT { return capacity_; }
+
+  std::size_t count() const _NOEXCEPT { return entries_.size(); }
+
+  std::uint64_t hitCount() const _NOEXCEPT { return hits_; }
+
+  std::uint64_t missCount() const _NOEXCEPT { return misses_; }
+
+ private:
+  struct Watcher {
+    uv_fs_event_t handle;
+    FileCache *cache;
+    std::string directory;
+    std::size_t references;
+  };
+
+  /// Holds a reference on `watcher`, handed to the entry or dropped.
+  struct Load {
+    uv_work_t work;
+    FileCache *cache;
+    uvcc::Tracer *tracer;
+    Watcher *watcher;
+    std::string path;
+    std::vector<FetchingCompletionBlock> waiters;
+    SharedBuffer *buffer = nullptr;
+    int status = 0;
+    bool stale = false;
+  };
+
+  struct Entry {
+    SharedBuffer *buffer;
+    std::list<std::string>::iterator position;
+    Watcher *directory;
+  };
+
+  uvcc::EventLoop *loop_;
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::unordered_map<std::string, Load *> loading_;
+  std::unordered_set<Load *> loads_;
+  std::unordered_map<std::string, Watcher *> watchers_;
+
+  SharedBuffer *_find(const std::string &path) _NOEXCEPT {
+    auto it = entries_.find(path);
+    if (it == entries_.end()) return nullptr;
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second.position);
+    return it->second.buffer;
+  }
+
+  void _invalidate(const std::string &path) _NOEXCEPT {
+    auto loading = loading_.find(path);
+    if (loading != loading_.end()) loading->second->stale = true;
+    auto it = entries_.find(path);
+    if (it == entries_.end()) return;
+    size_ -= it->second.buffer->size();
+    it->second.buffer->release();
+    lru_.erase(it->second.position);
+    _unwatch(it->second.directory);
+    entries_.erase(it);
+  }
+
+  /// Drops empty and `.` components and folds `..` into its parent.
+  static std::string _normalize(const std::string &path) {
+    auto absolute = !path.empty() && path[0] == '/';
+    std::vector<std::string> components;
+    std::size_t begin = 0;
+    while (begin <= path.size()) {
+      auto end = path.find('/', begin);
+      if (end == std::string::npos) end = path.size();
+      auto component = path.substr(begin, end - begin);
+      if (component == "..") {
+        if (!components.empty() && components.back() != "..")
+          components.pop_back();
+        else if (!absolute)
+          components.push_back(component);
+      } else if (!component.empty() && component != ".") {
+        components.push_back(component);
+      }
+      begin = end + 1;
+    }
+    std::string normalized = absolute ? "/" : "";
+    for (std::size_t i = 0; i < components.size(); ++i) {
+      if (i) normalized += '/';
+      normalized += components[i];
+    }
+    return normalized.empty() ? "." : normalized;
+  }
+
+  static std::string _directory(const std::string &path) {
+    auto slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+  }
+
+  static void _read(uv_work_t *work) {
+    auto load = static_cast<Load *>(work->data);
+    if (load->tracer) load->tracer->requestStarted(work, UV_WORK);
+    uv_fs_t request;
+    auto fd = uv_fs_open(nullptr, &request, load->path.c_str(), O_RDONLY, 0,
+                         nullptr);
+    uv_fs_req_cleanup(&request);
+    if (fd < 0) {
+      load->status = fd;
+      return;
+    }
+    load->status = uv_fs_fstat(nullptr, &request, fd, nullptr);
+    auto size = static_cast<std::size_t>(request.statbuf.st_size);
+    uv_fs_req_cleanup(&request);
+    if (load->status == 0) {
+      try {
+        load->buffer = SharedBuffer::make(size);
+      } catch (const std::bad_alloc &) {
+        load->status = UV_ENOMEM;
+      }
+    }
+    if (load->buffer) {
+      std::size_t offset = 0;
+      while (offset < size) {
+        auto buf = uv_buf_init(load->buffer->data() + offset,
+                               static_cast<unsigned int>(size - offset));
+        auto nread = uv_fs_read(nullptr, &request, fd, &buf, 1,
+                                static_cast<std::int64_t>(offset), nullptr);
+        uv_fs_req_cleanup(&request);
+        if (nread <= 0) {
+          load->status = nread < 0 ? nread : UV_EIO;
+          break;
+        }
+        offset += static_cast<std::size_t>(nread);
+      }
+    }
+    uv_fs_close(nullptr, &request, fd, nullptr);
+    uv_fs_req_cleanup(&request);
+  }
+
+  static void _loaded(uv_work_t *work, int status) {
+    std::unique_ptr<Load> load(static_cast<Load *>(work->data));
+    if (load->tracer) load->tracer->requestCompleted(work, UV_WORK);
+    if (status) load->status = status;
+    auto cache = load->cache;
+    if (cache) {
+      cache->loads_.erase(load.get());
+      cache->loading_.erase(load->path);
+    }
+    auto buffer = load->status ? nullptr : load->buffer;
+    if (cache && load->watcher &&
+        (!buffer || load->stale ||
+         !cache->_insert(load->path, buffer, load->watcher)))
+      cache->_unwatch(load->watcher);
+    for (auto &waiter : load->waiters) waiter(buffer, load->status);
+    if (load->buffer) load->buffer->release();
+  }
+
+  /// Takes over the load's reference on `watcher` unless it returns false.
+  bool _insert(const std::string &path, SharedBuffer *buffer,
+               Watcher *watcher) {
+    if (buffer->size() > capacity_) return false;
+    while (size_ + buffer->size() > capacity_ && !lru_.empty())
+      _invalidate(lru_.back());
+    lru_.push_front(path);
+    entries_.emplace(path, Entry{buffer->retain(), lru_.begin(), watcher});
+    size_ += buffer->size();
+    return true;
+  }
+
+  Watcher *_watch(const std::string &directory) {
+    auto it = watchers_.find(directory);
+    if (it != watchers_.end()) {
+      ++it->second->references;
+      return it->second;
+    }
+    auto watcher = new Watcher{uv_fs_event_t(), this, directory, 1};
+    uv_fs_event_init(loop_->raw_.get(), &watcher->handle);
+    watcher->handle.data = watcher;
+    auto err = uv_fs_event_start(
+        &watcher->handle,
+        [](uv_fs_event_t *handle, const char *filename, int, int status) {
+          auto watcher = static_cast<Watcher *>(handle->data);
+          watcher->cache->_changed(*watcher, filename, status);
+        },
+        directory.c_str(), 0);
+    if (err) {
+      _close(watcher);
+      // A missing directory only means the load will fail too.
+      if (err != UV_ENOENT && err != UV_ENOTDIR)
+        uvcc::expr_cerr(uvcc::Exception(err), UV_FS_EVENT);
+      return nullptr;
+    }
+    uv_unref(reinterpret_cast<uv_handle_t *>(&watcher->handle));
+    watchers_.emplace(directory, watcher);
+    return watcher;
+  }
+
+  void _unwatch(Watcher *watcher) _NOEXCEPT {
+    if (--watcher->references) return;
+    watchers_.erase(watcher->directory);
+    _close(watcher);
+  }
+
+  static void _close(Watcher *watcher) _NOEXCEPT {
+    uv_close(reinterpret_cast<uv_handle_t *>(&watcher->handle),
+             [](uv_handle_t *handle) {
+               delete static_cast<Watcher *>(handle->data);
+             });
+  }
+
+  void _changed(Watcher &watcher, const char *filename, int status) {
+    if (status < 0 || !filename) {
+      std::vector<std::string> stale;
+      for (auto &entry : entries_)
+        if (entry.second.directory == &watcher) stale.push_back(entry.first);
+      for (auto &path : stale) _invalidate(path);
+      return;
+    }
+    _invalidate(watcher.directory == "." ? filename
+               : watcher.directory == "/"
+                   ? "/" + std::string(filename)
+                   : watcher.directory + "/" + filename);
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // FILECACHE_H
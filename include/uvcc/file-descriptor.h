@@ -103,7 +103,7 @@ class FileDescriptor
         raw_->handle = decltype(raw_->handle)();
         break;
       default:
-        raw_ = uvcc::make_unique<Self>();
+        raw_ = _makeRaw();
         break;
     }
   }
@@ -162,15 +162,23 @@ class FileDescriptor
  protected:
   ClosingCompletionBlock closing_completion_block_;
 
+  /// Hands the storage over to the close callback, which frees it once libuv
+  /// is done with the handle; the descriptor is unusable afterwards.
   void _close() _NOEXCEPT {
-    if (_validateType())
-      uv_close(
-          _someRaw(),
-          closing_completion_block_
-              ? closing_completion_block_.target<ClosingRawCompletionBlock>()
-              : nullptr);
-    else
+    if (!raw_ || !_validateType() || !_someRaw()->loop ||
+        uv_is_closing(_someRaw()))
       return;
+    auto data = _someRaw()->data;
+    auto context = new ClosingContext{
+        std::move(raw_), std::move(closing_completion_block_), data};
+    auto handle = _someRawOf(context->storage);
+    handle->data = context;
+    uv_close(handle, [](uv_handle_t *handle) {
+      std::unique_ptr<ClosingContext> context(
+          static_cast<ClosingContext *>(handle->data));
+      handle->data = context->data;
+      if (context->block) context->block(handle);
+    });
   }
 
   inline virtual bool _validateType() const _NOEXCEPT {
@@ -179,6 +187,16 @@ class FileDescriptor
   }
 
  private:
+  struct ClosingContext {
+    Storage storage;
+    ClosingCompletionBlock block;
+    void *data;
+  };
+
+  static uv_handle_t *_someRawOf(const Storage &storage) _NOEXCEPT {
+    return reinterpret_cast<uv_handle_t *>(storage.get());
+  }
+
   inline TransmitType _type(const uv_handle_type &raw_type) const _NOEXCEPT {
     return static_cast<TransmitType>(raw_type);
   }
@@ -0,0 +1,206 @@
+/// MIT License
+///
+/// uvcc/handle-arena.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef HANDLEARENA_H
+#define HANDLEARENA_H
+
+#include <uv.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Per-loop pool of handle storage with one free list per handle type.
+/// `release()` closes a handle; its slot is parked until libuv has run the
+/// close callback and then handed back to the free list in one batch at the
+/// start of the next iteration, so storage is never reused while libuv may
+/// still reference it. Every handle must be released before the arena is
+/// destroyed.
+class HandleArena {
+ public:
+  static constexpr std::size_t kChunkSlots = 64;
+
+  explicit HandleArena(uv_loop_t *loop) : reclaimer_(new uv_prepare_t()) {
+    uvcc::expr_throws(uv_prepare_init(loop, reclaimer_));
+    reclaimer_->data = this;
+    uv_unref(reinterpret_cast<uv_handle_t *>(reclaimer_));
+  }
+  HandleArena(const HandleArena &) = delete;
+  HandleArena &operator=(const HandleArena &) = delete;
+  ~HandleArena() {
+    close();
+    for (auto chunk : chunks_) AllocationTracker::deallocate(chunk);
+  }
+
+  uv_handle_t *acquire(const uv_handle_type &type) {
+    if (type <= UV_UNKNOWN_HANDLE || type >= UV_HANDLE_TYPE_MAX)
+      uvcc::expr_throws(UV_EINVAL);
+    auto &list = lists_[type];
+    if (!list.free) list.pending ? _reclaim() : _grow(type);
+    auto slot = list.free;
+    list.free = slot->next;
+    slot->next = nullptr;
+    slot->callback = nullptr;
+    auto handle = _handle(slot);
+    std::memset(handle, 0, list.slot_size - kHeaderSize);
+    ++live_;
+    return handle;
+  }
+
+  template <typename T>
+  T *acquire(const uv_handle_type &type) {
+    return reinterpret_cast<T *>(acquire(type));
+  }
+
+  /// Closes `handle` (if it was ever initialised) and recycles its slot once
+  /// `callback` has run.
+  void release(uv_handle_t *handle, uv_close_cb callback = nullptr) _NOEXCEPT {
+    auto slot = _slot(handle);
+    slot->callback = callback;
+    if (handle->loop)
+      uv_close(handle, &HandleArena::_closed);
+    else
+      _closed(handle);
+  }
+
+  template <typename T>
+  void release(T *handle, uv_close_cb callback = nullptr) _NOEXCEPT {
+    release(reinterpret_cast<uv_handle_t *>(handle), callback);
+  }
+
+  /// Stops deferred reclamation; slots already closed are recycled at once.
+  void close() _NOEXCEPT {
+    if (!reclaimer_) return;
+    _reclaim();
+    uv_close(reinterpret_cast<uv_handle_t *>(reclaimer_),
+             [](uv_handle_t *handle) {
+               delete reinterpret_cast<uv_prepare_t *>(handle);
+             });
+    reclaimer_ = nullptr;
+  }
+
+  std::size_t liveCount() const _NOEXCEPT { return live_; }
+
+  std::size_t pendingCount() const _NOEXCEPT { return pending_; }
+
+  std::size_t capacity() const _NOEXCEPT {
+    return chunks_.size() * kChunkSlots;
+  }
+
+ private:
+  struct Slot {
+    Slot *next;
+    HandleArena *arena;
+    uv_close_cb callback;
+    uv_handle_type type;
+  };
+
+  struct List {
+    Slot *free = nullptr;
+    Slot *pending = nullptr;
+    Slot *pending_tail = nullptr;
+    std::size_t slot_size = 0;
+  };
+
+  static constexpr std::size_t kHeaderSize =
+      (sizeof(Slot) + alignof(std::max_align_t) - 1) &
+      ~(alignof(std::max_align_t) - 1);
+
+  uv_prepare_t *reclaimer_;
+  std::array<List, UV_HANDLE_TYPE_MAX> lists_;
+  std::vector<void *> chunks_;
+  std::size_t live_ = 0;
+  std::size_t pending_ = 0;
+
+  static uv_handle_t *_handle(Slot *slot) _NOEXCEPT {
+    return reinterpret_cast<uv_handle_t *>(reinterpret_cast<char *>(slot) +
+                                           kHeaderSize);
+  }
+
+  static Slot *_slot(uv_handle_t *handle) _NOEXCEPT {
+    return reinterpret_cast<Slot *>(reinterpret_cast<char *>(handle) -
+                                    kHeaderSize);
+  }
+
+  static void _closed(uv_handle_t *handle) {
+    auto slot = _slot(handle);
+    if (slot->callback) slot->callback(handle);
+    slot->arena->_defer(slot);
+  }
+
+  void _grow(const uv_handle_type &type) {
+    auto &list = lists_[type];
+    if (!list.slot_size)
+      list.slot_size = kHeaderSize + ((uv_handle_size(type) +
+                                       alignof(std::max_align_t) - 1) &
+                                      ~(alignof(std::max_align_t) - 1));
+    auto chunk = static_cast<char *>(AllocationTracker::allocate(
+        AllocationTracker::Subsystem::kHandles, list.slot_size * kChunkSlots));
+    chunks_.push_back(chunk);
+    for (std::size_t i = kChunkSlots; i-- > 0;) {
+      auto slot = reinterpret_cast<Slot *>(chunk + i * list.slot_size);
+      slot->arena = this;
+      slot->type = type;
+      slot->next = list.free;
+      list.free = slot;
+    }
+  }
+
+  void _defer(Slot *slot) _NOEXCEPT {
+    auto &list = lists_[slot->type];
+    slot->next = list.pending;
+    if (!list.pending) list.pending_tail = slot;
+    list.pending = slot;
+    --live_;
+    ++pending_;
+    if (pending_ == 1 && reclaimer_)
+      uv_prepare_start(reclaimer_, [](uv_prepare_t *handle) {
+        static_cast<HandleArena *>(handle->data)->_reclaim();
+      });
+  }
+
+  void _reclaim() _NOEXCEPT {
+    for (auto &list : lists_) {
+      if (!list.pending) continue;
+      list.pending_tail->next = list.free;
+      list.free = list.pending;
+      list.pending = list.pending_tail = nullptr;
+    }
+    pending_ = 0;
+    if (reclaimer_) uv_prepare_stop(reclaimer_);
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // HANDLEARENA_H
@@ -0,0 +1,487 @@
+/// MIT License
+///
+/// uvcc/http.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "network.h"
+#include "stream.h"
+#include "utilities.h"
+#include "view.h"
+
+namespace uvcc {
+
+namespace http {
+
+using View = uvcc::View;
+
+/// A parsed request. Every view points into the connection's read buffer
+/// and is only valid while the request handler runs.
+class Request {
+  friend class Parser;
+
+ public:
+  static constexpr std::size_t kMaxHeaders = 64;
+
+  struct Header {
+    View name;
+    View value;
+  };
+
+  View method() const _NOEXCEPT { return method_; }
+
+  View target() const _NOEXCEPT { return target_; }
+
+  int minorVersion() const _NOEXCEPT { return minor_version_; }
+
+  std::size_t headerCount() const _NOEXCEPT { return header_count_; }
+
+  const Header &header(std::size_t index) const _NOEXCEPT {
+    return headers_[index];
+  }
+
+  /// Value of the first header called `name`, empty when absent.
+  View header(const char *name) const _NOEXCEPT {
+    for (std::size_t i = 0; i < header_count_; ++i)
+      if (headers_[i].name.equalsIgnoringCase(name)) return headers_[i].value;
+    return View();
+  }
+
+  View body() const _NOEXCEPT { return body_; }
+
+  bool keepAlive() const _NOEXCEPT { return keep_alive_; }
+
+ private:
+  View method_;
+  View target_;
+  int minor_version_ = 1;
+  Header headers_[kMaxHeaders];
+  std::size_t header_count_ = 0;
+  View body_;
+  bool keep_alive_ = true;
+};
+
+/// In-place HTTP/1.1 request parser; nothing is copied out of the buffer.
+class Parser {
+ public:
+  struct Limits {
+    std::size_t max_header_bytes = 64 * 1024;
+    std::size_t max_body_bytes = 1024 * 1024;
+  };
+
+  /// Parses one request from `data`. Returns the bytes it spans, 0 when more
+  /// input is needed, or the negated status code to reject it with.
+  /// `scanned` remembers how far the header terminator search got.
+  static long parse(const char *data, std::size_t size, const Limits &limits,
+                    Request &request, std::size_t &scanned) _NOEXCEPT {
+    auto head = _findHeaderEnd(data, size, scanned);
+    if (!head) return size > limits.max_header_bytes ? -431 : 0;
+    if (head > limits.max_header_bytes) return -431;
+
+    auto cursor = data, end = data + head - 2;
+    auto line = _line(cursor, end);
+    auto space = static_cast<const char *>(std::memchr(line.data(), ' ', line.size()));
+    if (!space || space == line.data()) return -400;
+    request.method_ = View(line.data(), space - line.data());
+    auto target = space + 1;
+    auto line_end = line.data() + line.size();
+    space = static_cast<const char *>(std::memchr(target, ' ', line_end - target));
+    if (!space || space == target) return -400;
+    request.target_ = View(target, space - target);
+    View version(space + 1, line_end - space - 1);
+    if (version.equals("HTTP/1.1"))
+      request.minor_version_ = 1;
+    else if (version.equals("HTTP/1.0"))
+      request.minor_version_ = 0;
+    else
+      return -505;
+
+    request.header_count_ = 0;
+    request.keep_alive_ = request.minor_version_ == 1;
+    std::size_t content_length = 0;
+    bool has_length = false;
+    while (cursor < end) {
+      line = _line(cursor, end);
+      auto colon = static_cast<const char *>(std::memchr(line.data(), ':', line.size()));
+      if (!colon || colon == line.data() || line.data()[0] == ' ' ||
+          line.data()[0] == '\t')
+        return -400;
+      if (request.header_count_ == Request::kMaxHeaders) return -431;
+      auto &header = request.headers_[request.header_count_++];
+      header.name = View(line.data(), colon - line.data());
+      header.value = _trim(colon + 1, line.data() + line.size());
+      if (header.name.equalsIgnoringCase("content-length")) {
+        if (has_length || !_number(header.value, content_length)) return -400;
+        has_length = true;
+      } else if (header.name.equalsIgnoringCase("transfer-encoding")) {
+        return -501;
+      } else if (header.name.equalsIgnoringCase("connection")) {
+        if (header.value.containsIgnoringCase("close"))
+          request.keep_alive_ = false;
+        else if (header.value.containsIgnoringCase("keep-alive"))
+          request.keep_alive_ = true;
+      }
+    }
+    if (content_length > limits.max_body_bytes) return -413;
+    if (size - head < content_length) return 0;
+    request.body_ = View(data + head, content_length);
+    scanned = 0;
+    return static_cast<long>(head + content_length);
+  }
+
+ private:
+  static std::size_t _findHeaderEnd(const char *data, std::size_t size,
+                                    std::size_t &scanned) _NOEXCEPT {
+    auto from = scanned > 3 ? scanned - 3 : 0;
+    for (auto p = data + from; p + 4 <= data + size;) {
+      p = static_cast<const char *>(std::memchr(p, '\r', data + size - p));
+      if (!p || p + 4 > data + size) break;
+      if (p[1] == '\n' && p[2] == '\r' && p[3] == '\n')
+        return static_cast<std::size_t>(p - data) + 4;
+      ++p;
+    }
+    scanned = size;
+    return 0;
+  }
+
+  static View _line(const char *&cursor, const char *end) _NOEXCEPT {
+    auto start = cursor;
+    while (cursor + 1 < end && !(cursor[0] == '\r' && cursor[1] == '\n'))
+      ++cursor;
+    if (cursor + 1 >= end) cursor = end;
+    View line(start, cursor - start);
+    cursor = cursor < end ? cursor + 2 : end;
+    return line;
+  }
+
+  static View _trim(const char *begin, const char *end) _NOEXCEPT {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    return View(begin, end - begin);
+  }
+
+  static bool _number(const View &value, std::size_t &number) _NOEXCEPT {
+    if (value.isEmpty() || value.size() > 18) return false;
+    number = 0;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+      auto c = value.data()[i];
+      if (c < '0' || c > '9') return false;
+      number = number * 10 + static_cast<std::size_t>(c - '0');
+    }
+    return true;
+  }
+};
+
+class Server;
+
+/// Response to one request. Responses on a connection are written in request
+/// order: one that ends early waits for the ones before it.
+class Response {
+  friend class Server;
+
+ public:
+  Response &setStatus(int code) _NOEXCEPT {
+    status_ = code;
+    return *this;
+  }
+
+  Response &setHeader(const std::string &name, const std::string &value) {
+    headers_.append(name).append(": ").append(value).append("\r\n");
+    return *this;
+  }
+
+  /// Closes the connection after this response has been written.
+  Response &setClosing(bool closing) _NOEXCEPT {
+    closing_ = closing;
+    return *this;
+  }
+
+  void end(const std::string &body = std::string()) {
+    end(body.data(), body.size());
+  }
+
+  void end(const char *body, std::size_t size);
+
+  bool isFinished() const _NOEXCEPT { return finished_; }
+
+  int status() const _NOEXCEPT { return status_; }
+
+ private:
+  std::weak_ptr<void> session_;
+  Server *server_ = nullptr;
+  int status_ = 200;
+  bool head_only_ = false;
+  bool http10_ = false;
+  bool closing_ = false;
+  bool finished_ = false;
+  std::string headers_;
+  std::string wire_;
+
+  static const char *_reason(int code) _NOEXCEPT {
+    switch (code) {
+      case 100: return "Continue";
+      case 200: return "OK";
+      case 201: return "Created";
+      case 204: return "No Content";
+      case 301: return "Moved Permanently";
+      case 302: return "Found";
+      case 304: return "Not Modified";
+      case 400: return "Bad Request";
+      case 403: return "Forbidden";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 413: return "Payload Too Large";
+      case 431: return "Request Header Fields Too Large";
+      case 500: return "Internal Server Error";
+      case 501: return "Not Implemented";
+      case 503: return "Service Unavailable";
+      case 505: return "HTTP Version Not Supported";
+      default: return "Unknown";
+    }
+  }
+};
+
+/// HTTP/1.1 server on top of a `network::Listener`: keep-alive, pipelining
+/// with in-order responses (coalesced through corked writes) and in-place
+/// request parsing. Chunked request bodies are answered with 501.
+class Server {
+  friend class Response;
+
+ public:
+  using RequestHandler =
+      std::function<void(const Request &, const std::shared_ptr<Response> &)>;
+
+  struct Options {
+    Parser::Limits limits;
+    /// Reading pauses while this many responses are outstanding.
+    std::size_t max_pipelined = 32;
+    std::size_t read_size = 16 * 1024;
+  };
+
+  Server(network::Listener &listener, RequestHandler &&handler)
+      : Server(listener, std::move(handler), Options()) {}
+  Server(network::Listener &listener, RequestHandler &&handler,
+         const Options &options)
+      : handler_(std::move(handler)), options_(options) {
+    listener.newConnectionHandler =
+        uvcc::make_unique<std::function<void(const network::Connection &)>>(
+            [this](const network::Connection &connection) {
+              _open(connection.sharedStream());
+            });
+  }
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+  ~Server() { sessions_.clear(); }
+
+  std::size_t connectionCount() const _NOEXCEPT { return sessions_.size(); }
+
+ private:
+  struct Session {
+    Session(Server *server, std::shared_ptr<uvcc::Stream> stream)
+        : server(server), stream(std::move(stream)) {}
+
+    Server *server;
+    std::shared_ptr<uvcc::Stream> stream;
+    std::vector<char> input;
+    std::size_t length = 0;
+    std::size_t scanned = 0;
+    std::deque<std::shared_ptr<Response>> pending;
+    bool reading = false;
+    bool processing = false;
+    bool closing = false;
+    // A response that closes the connection is queued; no further input is
+    // read or parsed even once the responses ahead of it are flushed.
+    bool close_pending = false;
+  };
+
+  RequestHandler handler_;
+  Options options_;
+  std::unordered_map<Session *, std::shared_ptr<Session>> sessions_;
+
+  void _open(const std::shared_ptr<uvcc::Stream> &stream) {
+    auto session = std::make_shared<Session>(this, stream);
+    sessions_.emplace(session.get(), session);
+    try {
+      stream->setCorked(true);
+      _resume(*session);
+    } catch (const uvcc::Exception &exception) {
+      uvcc::expr_cerr(exception, UV_TCP);
+      sessions_.erase(session.get());
+    }
+  }
+
+  void _resume(Session &session) {
+    if (session.reading || session.closing || session.close_pending) return;
+    session.reading = true;
+    auto target = &session;
+    session.stream->startReading(
+        [this, target](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+          auto &input = target->input;
+          if (input.size() - target->length < options_.read_size)
+            input.resize(target->length + options_.read_size);
+          *buf = uv_buf_init(input.data() + target->length,
+                             static_cast<unsigned int>(input.size() -
+                                                       target->length));
+        },
+        [this, target](uv_stream_t *, ssize_t nread, const uv_buf_t *) {
+          if (nread < 0) {
+            if (nread != UV_EOF)
+              uvcc::expr_cerr(uvcc::Exception(static_cast<int>(nread)),
+                              UV_TCP);
+            return _close(*target);
+          }
+          target->length += static_cast<std::size_t>(nread);
+          _process(*target);
+        });
+  }
+
+  void _pause(Session &session) _NOEXCEPT {
+    if (!session.reading) return;
+    session.reading = false;
+    session.stream->stopReading();
+  }
+
+  void _process(Session &session) {
+    auto keeper = sessions_.at(&session);
+    session.processing = true;
+    std::size_t offset = 0;
+    Request request;
+    while (!session.closing && !session.close_pending &&
+           offset < session.length &&
+           session.pending.size() < options_.max_pipelined) {
+      auto consumed =
+          Parser::parse(session.input.data() + offset, session.length - offset,
+                        options_.limits, request, session.scanned);
+      if (consumed == 0) break;
+      auto response = std::make_shared<Response>();
+      response->session_ = keeper;
+      response->server_ = this;
+      session.pending.push_back(response);
+      if (consumed < 0) {
+        session.close_pending = true;
+        _pause(session);
+        response->setStatus(static_cast<int>(-consumed)).setClosing(true);
+        response->end();
+        offset = session.length;
+        break;
+      }
+      offset += static_cast<std::size_t>(consumed);
+      response->head_only_ = request.method().equals("HEAD");
+      response->http10_ = request.minorVersion() == 0;
+      response->closing_ = !request.keepAlive();
+      if (response->closing_) {
+        session.close_pending = true;
+        _pause(session);
+      }
+      handler_(request, response);
+      if (response->closing_) break;
+    }
+    if (offset) {
+      std::memmove(session.input.data(), session.input.data() + offset,
+                   session.length - offset);
+      session.length -= offset;
+      session.scanned = 0;
+    }
+    session.processing = false;
+    if (session.pending.size() >= options_.max_pipelined) _pause(session);
+  }
+
+  void _flush(Session &session) {
+    while (!session.pending.empty() && session.pending.front()->finished_) {
+      auto response = session.pending.front();
+      session.pending.pop_front();
+      auto buf = uv_buf_init(&response->wire_[0],
+                             static_cast<unsigned int>(response->wire_.size()));
+      std::weak_ptr<Session> weak = sessions_.at(&session);
+      auto closing = response->closing_;
+      session.stream->write(
+          buf, [this, weak, response, closing](uv_write_t *, int status) {
+            auto session = weak.lock();
+            if (!session) return;
+            if (status < 0 || closing) _close(*session);
+          });
+      if (closing) {
+        session.closing = true;
+        _pause(session);
+        session.pending.clear();
+        return;
+      }
+    }
+    if (!session.closing && !session.close_pending &&
+        session.pending.size() < options_.max_pipelined) {
+      _resume(session);
+      if (session.length && !session.processing) _process(session);
+    }
+  }
+
+  void _close(Session &session) _NOEXCEPT {
+    session.closing = true;
+    _pause(session);
+    sessions_.erase(&session);
+  }
+};
+
+inline void Response::end(const char *body, std::size_t size) {
+  if (finished_) return;
+  finished_ = true;
+  auto session = std::static_pointer_cast<Server::Session>(session_.lock());
+  if (!session) return;
+  auto reason = _reason(status_);
+  wire_.reserve(64 + headers_.size() + size);
+  wire_.append("HTTP/1.1 ").append(std::to_string(status_)).append(" ");
+  wire_.append(reason).append("\r\n").append(headers_);
+  wire_.append("Content-Length: ").append(std::to_string(size)).append("\r\n");
+  if (closing_)
+    wire_.append("Connection: close\r\n");
+  else if (http10_)
+    // HTTP/1.0 clients assume a close unless told otherwise.
+    wire_.append("Connection: keep-alive\r\n");
+  wire_.append("\r\n");
+  if (!head_only_) wire_.append(body, size);
+  headers_.clear();
+  if (closing_) {
+    session->close_pending = true;
+    server_->_pause(*session);
+  }
+  server_->_flush(*session);
+}
+
+}  // namespace http
+
+}  // namespace uvcc
+
+#endif  // HTTP_H
@@ -0,0 +1,338 @@
+/// MIT License
+///
+/// uvcc/logger.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "exception.h"
+#include "ring-buffer.h"
+
+namespace uvcc {
+
+/// Asynchronous logger. Producers (normally loop threads) only ever touch a
+/// thread-local lock-free channel; a background thread drains every channel
+/// into the installed `Sink`, so a slow sink can never stall I/O. When a
+/// channel is full the record is dropped and accounted for instead.
+class Logger {
+ public:
+  enum class Level : int {
+    kDebug,
+    kInfo,
+    kWarning,
+    kError,
+  };
+
+  static constexpr std::size_t kContextSize = 64;
+
+  /// `context` is copied in, truncated to fit, and empty when none was given.
+  struct Record {
+    Level level;
+    int code;
+    uv_handle_type handle_type;
+    std::uint64_t timestamp;
+    std::uint64_t suppressed;
+    char context[kContextSize];
+  };
+
+  class Sink {
+   public:
+    virtual ~Sink() = default;
+
+    virtual void write(const Record &record) = 0;
+
+    virtual void flush() {}
+  };
+
+  class StandardErrorSink : public Sink {
+   public:
+    void write(const Record &record) override {
+      std::fprintf(stderr, "uvcc [%s]", _levelName(record.level));
+      if (record.code != 0)
+        std::fprintf(stderr, " %s(%d) %s", uv_err_name(record.code),
+                     record.code, uv_strerror(record.code));
+      if (record.context[0]) std::fprintf(stderr, " %s", record.context);
+      if (record.handle_type > UV_UNKNOWN_HANDLE &&
+          record.handle_type < UV_HANDLE_TYPE_MAX)
+        std::fprintf(stderr, " handle=%s",
+                     uv_handle_type_name(record.handle_type));
+      if (record.suppressed)
+        std::fprintf(stderr, " suppressed=%llu",
+                     static_cast<unsigned long long>(record.suppressed));
+      std::fputc('\n', stderr);
+    }
+
+    void flush() override { std::fflush(stderr); }
+
+   private:
+    static const char *_levelName(const Level &level) _NOEXCEPT {
+      switch (level) {
+        case Level::kDebug:
+          return "debug";
+        case Level::kInfo:
+          return "info";
+        case Level::kWarning:
+          return "warning";
+        default:
+          return "error";
+      }
+    }
+  };
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+  ~Logger() {
+    running_.store(false, std::memory_order_release);
+    if (worker_.joinable()) worker_.join();
+    _drain();
+  }
+
+  static Logger &shared() _NOEXCEPT {
+    static Logger logger;
+    return logger;
+  }
+
+  void setSink(std::shared_ptr<Sink> sink) {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    sink_ = sink ? std::move(sink) : std::make_shared<StandardErrorSink>();
+  }
+
+  void setLevel(const Level &level) _NOEXCEPT {
+    level_.store(level, std::memory_order_relaxed);
+  }
+
+  /// Lets through at most `burst` records per error code every
+  /// `interval_ms`; the rest are counted and reported on the next record
+  /// admitted for that code. A `burst` of 0 disables rate limiting.
+  void setRateLimit(std::uint32_t burst, std::uint64_t interval_ms) _NOEXCEPT {
+    burst_.store(burst, std::memory_order_relaxed);
+    interval_.store(interval_ms * 1000000, std::memory_order_relaxed);
+  }
+
+  void log(const Level &level, int code,
+           uv_handle_type handle_type = UV_UNKNOWN_HANDLE,
+           const char *context = nullptr) _NOEXCEPT {
+    if (level < level_.load(std::memory_order_relaxed)) return;
+    auto producer = _producer();
+    if (!producer) return;
+    auto now = uv_hrtime();
+    std::uint64_t suppressed = 0;
+    Limiter::Slot evicted = {};
+    if (!producer->limiter.admit(level, code, now,
+                                 burst_.load(std::memory_order_relaxed),
+                                 interval_.load(std::memory_order_relaxed),
+                                 suppressed, evicted))
+      return;
+    if (evicted.suppressed) {
+      // The count would otherwise be lost with the slot.
+      Record summary = {evicted.level, evicted.code, UV_UNKNOWN_HANDLE, now,
+                        evicted.suppressed, {}};
+      if (!producer->channel->ring.push(summary))
+        producer->channel->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    Record record = {level, code, handle_type, now, suppressed, {}};
+    if (context) std::strncpy(record.context, context, kContextSize - 1);
+    if (!producer->channel->ring.push(record))
+      producer->channel->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void error(const uvcc::Exception &exception,
+             uv_handle_type handle_type = UV_UNKNOWN_HANDLE,
+             const char *context = nullptr) _NOEXCEPT {
+    log(Level::kError, exception.rawCode(), handle_type, context);
+  }
+
+  /// Synchronously drains every channel; meant for shutdown paths only.
+  void flush() { _drain(); }
+
+ private:
+  static constexpr std::size_t kChannelCapacity = 1024;
+  static constexpr std::size_t kLimiterSlots = 64;
+  static constexpr std::size_t kLimiterProbes = 4;
+
+  struct Channel {
+    Channel() : ring(kChannelCapacity) {}
+
+    RingBuffer<Record> ring;
+    std::atomic<std::uint64_t> dropped{0};
+  };
+
+  /// Per-code windows in a small open-addressed table. A code whose probe
+  /// run is full takes over the slot with the oldest window, and a slot
+  /// taken over while still owing a suppressed count hands it back through
+  /// `evicted` so that it is reported rather than lost.
+  class Limiter {
+   public:
+    struct Slot {
+      Level level;
+      int code;
+      std::uint32_t count;
+      std::uint64_t window_start;
+      std::uint64_t suppressed;
+    };
+
+    bool admit(const Level &level, int code, std::uint64_t now,
+               std::uint32_t burst, std::uint64_t interval,
+               std::uint64_t &suppressed, Slot &evicted) _NOEXCEPT {
+      if (burst == 0) return true;
+      auto home = static_cast<std::uint32_t>(code) * 2654435761u;
+      Slot *victim = nullptr;
+      for (std::size_t i = 0; i < kLimiterProbes; ++i) {
+        auto &slot = slots_[(home + i) % kLimiterSlots];
+        if (slot.count && slot.code == code) {
+          if (now - slot.window_start >= interval) {
+            suppressed = slot.suppressed;
+            slot = {level, code, 1, now, 0};
+            return true;
+          }
+          if (slot.count < burst) {
+            ++slot.count;
+            return true;
+          }
+          ++slot.suppressed;
+          return false;
+        }
+        // Unused slots have never opened a window, so they go first.
+        if (!victim || slot.window_start < victim->window_start)
+          victim = &slot;
+      }
+      if (victim->count && victim->suppressed) evicted = *victim;
+      *victim = {level, code, 1, now, 0};
+      return true;
+    }
+
+   private:
+    Slot slots_[kLimiterSlots] = {};
+  };
+
+  struct Producer {
+    std::shared_ptr<Channel> channel;
+    Limiter limiter;
+  };
+
+  std::mutex channels_mutex_;
+  std::vector<std::shared_ptr<Channel>> channels_;
+  std::mutex sink_mutex_;
+  std::shared_ptr<Sink> sink_ = std::make_shared<StandardErrorSink>();
+  std::atomic<Level> level_{Level::kDebug};
+  std::atomic<std::uint32_t> burst_{16};
+  std::atomic<std::uint64_t> interval_{1000000000};
+  std::atomic<bool> running_{false};
+  std::thread worker_;
+
+  Logger() = default;
+
+  /// This thread's producer, or null when its channel cannot be allocated;
+  /// registration is retried on the next record.
+  Producer *_producer() _NOEXCEPT {
+    static thread_local Producer producer;
+    if (!producer.channel) {
+      try {
+        producer.channel = _register();
+      } catch (...) {
+        return nullptr;
+      }
+    }
+    return &producer;
+  }
+
+  std::shared_ptr<Channel> _register() {
+    auto channel = std::make_shared<Channel>();
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    channels_.push_back(channel);
+    if (!running_.exchange(true, std::memory_order_acq_rel)) {
+      try {
+        worker_ = std::thread([this] { _run(); });
+      } catch (const std::system_error &) {
+        // Records wait for flush() or the next registration to try again.
+        running_.store(false, std::memory_order_release);
+      }
+    }
+    return channel;
+  }
+
+  void _run() {
+    auto backoff = std::chrono::milliseconds(1);
+    while (running_.load(std::memory_order_acquire)) {
+      if (_drain()) {
+        backoff = std::chrono::milliseconds(1);
+      } else {
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, std::chrono::milliseconds(50));
+      }
+    }
+  }
+
+  bool _drain() {
+    std::vector<std::shared_ptr<Channel>> channels;
+    {
+      std::lock_guard<std::mutex> lock(channels_mutex_);
+      channels_.erase(
+          std::remove_if(channels_.begin(), channels_.end(),
+                         [](const std::shared_ptr<Channel> &channel) {
+                           return channel.use_count() == 1 &&
+                                  channel->ring.isEmpty();
+                         }),
+          channels_.end());
+      channels = channels_;
+    }
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    std::size_t count = 0;
+    Record record;
+    for (auto &channel : channels) {
+      while (channel->ring.pop(record)) {
+        sink_->write(record);
+        ++count;
+      }
+      auto dropped = channel->dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped) {
+        sink_->write({Level::kWarning, 0, UV_UNKNOWN_HANDLE, uv_hrtime(),
+                      dropped, "log channel overflow"});
+        ++count;
+      }
+    }
+    if (count) sink_->flush();
+    return count > 0;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // LOGGER_H
@@ -0,0 +1,109 @@
+/// MIT License
+///
+/// uvcc/loop-embedder.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef LOOPEMBEDDER_H
+#define LOOPEMBEDDER_H
+
+#include <uv.h>
+
+#include <functional>
+
+#include "event-loop.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Drives an `EventLoop` from a foreign reactor on the reactor's own thread.
+/// The loop's backend fd is watched for readability and its next timeout is
+/// armed as a one-shot timer; either firing runs a single non-blocking
+/// iteration and re-arms the timer, so no thread ever blocks in `uv_run`.
+class LoopEmbedder {
+ public:
+  /// What the host event system has to provide. Callbacks must be invoked
+  /// on the thread that owns the loop.
+  class Reactor {
+   public:
+    using ReadyCompletionBlock = std::function<void()>;
+
+    virtual ~Reactor() = default;
+
+    /// Level-triggered readability watch on `fd`.
+    virtual void watch(int fd, ReadyCompletionBlock &&block) = 0;
+
+    virtual void unwatch(int fd) = 0;
+
+    /// Arms the single one-shot timer, replacing any previous one; a
+    /// negative `timeout` (milliseconds) only cancels it.
+    virtual void schedule(int timeout, ReadyCompletionBlock &&block) = 0;
+  };
+
+  LoopEmbedder(uvcc::EventLoop &loop, Reactor &reactor) _NOEXCEPT
+      : loop_(loop),
+        reactor_(reactor) {}
+  LoopEmbedder(const LoopEmbedder &) = delete;
+  LoopEmbedder &operator=(const LoopEmbedder &) = delete;
+  ~LoopEmbedder() { detach(); }
+
+  void attach() {
+    if (fd_ >= 0) return;
+    fd_ = loop_.fd();
+    if (fd_ < 0) uvcc::expr_throws(UV_ENOTSUP);
+    reactor_.watch(fd_, [this] { process(); });
+    _rearm();
+  }
+
+  void detach() _NOEXCEPT {
+    if (fd_ < 0) return;
+    reactor_.unwatch(fd_);
+    reactor_.schedule(-1, {});
+    fd_ = -1;
+  }
+
+  bool isAttached() const _NOEXCEPT { return fd_ >= 0; }
+
+  /// Runs one non-blocking iteration and re-arms the timer.
+  void process() {
+    loop_.run(uvcc::RunOption::kNoWait);
+    if (fd_ >= 0) _rearm();
+  }
+
+ private:
+  uvcc::EventLoop &loop_;
+  Reactor &reactor_;
+  int fd_ = -1;
+
+  void _rearm() {
+    loop_.updateTime();
+    auto timeout = loop_.isAlive() ? loop_.timeout() : -1;
+    reactor_.schedule(timeout, timeout < 0 ? Reactor::ReadyCompletionBlock()
+                                           : [this] { process(); });
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // LOOPEMBEDDER_H
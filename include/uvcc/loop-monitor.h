@@ -0,0 +1,103 @@
+/// MIT License
+///
+/// uvcc/loop-monitor.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef LOOPMONITOR_H
+#define LOOPMONITOR_H
+
+#include <uv.h>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Measures how busy a loop is. `lag()` is a moving average of the time
+/// each iteration spends outside the poll wait, and `idleRatio()` is the
+/// share of the last window spent waiting. Sampling turns on idle time
+/// metrics for the loop and does not keep it alive.
+class LoopMonitor {
+ public:
+  explicit LoopMonitor(uv_loop_t *loop, std::uint64_t window = 250)
+      : window_(window * 1000000), prepare_(new uv_prepare_t()) {
+    uv_loop_configure(loop, UV_METRICS_IDLE_TIME);
+    uv_prepare_init(loop, prepare_);
+    prepare_->data = this;
+    uv_prepare_start(prepare_, [](uv_prepare_t *handle) {
+      static_cast<LoopMonitor *>(handle->data)->_sample();
+    });
+    uv_unref(reinterpret_cast<uv_handle_t *>(prepare_));
+  }
+  LoopMonitor(const LoopMonitor &) = delete;
+  LoopMonitor &operator=(const LoopMonitor &) = delete;
+  ~LoopMonitor() {
+    uv_close(reinterpret_cast<uv_handle_t *>(prepare_),
+             [](uv_handle_t *handle) {
+               delete reinterpret_cast<uv_prepare_t *>(handle);
+             });
+  }
+
+  /// Average busy time per iteration in microseconds.
+  std::uint64_t lag() const _NOEXCEPT { return lag_ / 1000; }
+
+  double idleRatio() const _NOEXCEPT { return idle_ratio_; }
+
+  std::uint64_t iterationCount() const _NOEXCEPT { return iterations_; }
+
+ private:
+  std::uint64_t window_;
+  uv_prepare_t *prepare_;
+  std::uint64_t lag_ = 0;
+  double idle_ratio_ = 1;
+  std::uint64_t iterations_ = 0;
+  std::uint64_t last_ = 0, last_idle_ = 0;
+  std::uint64_t window_start_ = 0, window_idle_ = 0;
+
+  void _sample() _NOEXCEPT {
+    auto now = uv_hrtime();
+    auto idle = uv_metrics_idle_time(prepare_->loop);
+    if (last_) {
+      auto elapsed = now - last_, waited = idle - last_idle_;
+      auto busy = elapsed > waited ? elapsed - waited : 0;
+      lag_ = iterations_ ? (lag_ * 7 + busy) / 8 : busy;
+      ++iterations_;
+    } else {
+      window_start_ = now;
+      window_idle_ = idle;
+    }
+    last_ = now;
+    last_idle_ = idle;
+    if (now - window_start_ >= window_) {
+      idle_ratio_ = static_cast<double>(idle - window_idle_) /
+                    static_cast<double>(now - window_start_);
+      window_start_ = now;
+      window_idle_ = idle;
+    }
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // LOOPMONITOR_H
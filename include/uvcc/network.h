@@ -30,7 +30,15 @@
 #include <sys/socket.h>
 #include <uv.h>
 
+#include <algorithm>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 #include "event-loop.h"
+#include "stream.h"
 #include "utilities.h"
 
 namespace uvcc {
@@ -49,6 +57,8 @@ typedef union {
 } AnyRawSocketAddress;
 
 class Endpoint : protected BaseObject<sockaddr, AnyRawSocketEndpoint> {
+  friend class Listener;
+
  public:
   template <typename AddressType>
   class BaseIPAddress
@@ -80,11 +90,11 @@ class Endpoint : protected BaseObject<sockaddr, AnyRawSocketEndpoint> {
       raw_->addr_4_ = std::move(addr);
     }
     IPv4Address(const IPv4Address &addr) {
-      raw_ = uvcc::make_unique<Self>(*addr.raw_);
+      raw_ = _makeRaw(*addr.raw_);
     }
     IPv4Address(IPv4Address &&) _NOEXCEPT = default;
     IPv4Address &operator=(const IPv4Address &addr) {
-      if (&addr != this) this->raw_.reset(addr.raw_.get());
+      if (&addr != this) raw_ = _makeRaw(*addr.raw_);
       return *this;
     }
     IPv4Address &operator=(IPv4Address &&) _NOEXCEPT = default;
@@ -136,19 +146,18 @@ class Endpoint : protected BaseObject<sockaddr, AnyRawSocketEndpoint> {
     kSocks = 1080,
   } Port;
 
-  explicit Endpoint(const IPv4Address &address, const Port &port) {
-    Endpoint(address, static_cast<std::uint16_t>(port));
-  }
+  explicit Endpoint(const IPv4Address &address, const Port &port)
+      : Endpoint(address, static_cast<std::uint16_t>(port)) {}
   explicit Endpoint(const IPv4Address &address, const std::uint16_t &port) {
     raw_->addr_in_4_ = decltype(raw_->addr_in_4_)();
     raw_->addr_in_4_.sin_family = AF_INET;
     raw_->addr_in_4_.sin_addr = *address._someRaw();
     raw_->addr_in_4_.sin_port = htons(port);
   }
-  Endpoint(const Endpoint &ep) { raw_ = uvcc::make_unique<Self>(*ep.raw_); }
+  Endpoint(const Endpoint &ep) { raw_ = _makeRaw(*ep.raw_); }
   Endpoint(Endpoint &&) _NOEXCEPT = default;
   Endpoint &operator=(const Endpoint &ep) {
-    if (&ep != this) this->raw_.reset(ep.raw_.get());
+    if (&ep != this) raw_ = _makeRaw(*ep.raw_);
     return *this;
   }
   Endpoint &operator=(Endpoint &&) = default;
@@ -161,6 +170,8 @@ class Endpoint : protected BaseObject<sockaddr, AnyRawSocketEndpoint> {
       return 0;
   }
 
+  const sockaddr *sockAddress() const _NOEXCEPT { return _someRaw(); }
+
   std::string addrString() const _NOEXCEPT {
     auto family = _someRaw()->sa_family;
     if (family == AF_INET) {
@@ -180,9 +191,8 @@ class Parameters {
      public:
       virtual ~Options() = 0;
     };
-    class
 
-        virtual ~Protocol() = 0;
+    virtual ~Protocol() = 0;
   };
 
   class ProtocolTCP : virtual protected Protocol {
@@ -195,6 +205,17 @@ class Connection {
   friend class Endpoint;
 
  public:
+  explicit Connection(std::shared_ptr<uvcc::Stream> stream) _NOEXCEPT
+      : stream_(std::move(stream)) {}
+
+  uvcc::Stream &stream() const _NOEXCEPT { return *stream_; }
+
+  const std::shared_ptr<uvcc::Stream> &sharedStream() const _NOEXCEPT {
+    return stream_;
+  }
+
+ private:
+  std::shared_ptr<uvcc::Stream> stream_;
 };
 
 class Listener {
@@ -210,6 +231,20 @@ class Listener {
     kCancelled,
   };
 
+  /// Admission thresholds against the loop's `LoopMonitor`; zero disables
+  /// either. Above them the listener moves to `kWaiting` and leaves new
+  /// connections in the kernel backlog, or with `reject` accepts and resets
+  /// them at once. It returns to `kReady` below half the lag and above the
+  /// idle ratio halfway between `min_idle_ratio` and 1, checking every
+  /// `interval` milliseconds meanwhile.
+  struct AdmissionOptions {
+    /// Loop lag in microseconds, as `LoopMonitor::lag()` reports it.
+    std::uint64_t max_lag = 0;
+    double min_idle_ratio = 0;
+    bool reject = false;
+    std::uint64_t interval = 10;
+  };
+
   Listener() = delete;
   explicit Listener(const Parameters &params, const Endpoint::Port &port)
       : ep_(uvcc::make_unique<Endpoint>(Endpoint::IPv4Address::any(), port)),
@@ -217,31 +252,272 @@ class Listener {
   explicit Listener(const Parameters &params, const std::uint16_t &port)
       : ep_(uvcc::make_unique<Endpoint>(Endpoint::IPv4Address::any(), port)),
         state_(State::kSetup) {}
+  explicit Listener(const Parameters &params, const Endpoint &endpoint)
+      : ep_(uvcc::make_unique<Endpoint>(endpoint)), state_(State::kSetup) {}
   Listener(const Listener &) = delete;
   Listener(Listener &&) _NOEXCEPT = default;
   Listener &operator=(const Listener &) = delete;
   Listener &operator=(Listener &&) _NOEXCEPT = default;
-  ~Listener() = default;
+  ~Listener() {
+    if (rechecking_) loop_->throttle().cancel(this);
+    _closeIdle();
+  }
 
-  void start(const EventLoop &loop = *EventLoop::standard()) {}
+  /// Binds and starts listening on `loop`; the listener must not be moved
+  /// afterwards. Accepted connections go to `newConnectionHandler`.
+  void start(uvcc::EventLoop &loop) {
+    if (server_) uvcc::expr_throws(UV_EALREADY);
+    loop_ = &loop;
+    server_ = uvcc::make_unique<uvcc::Stream>(uvcc::Stream::TransmitType::kTCP);
+    try {
+      server_->open(loop);
+      uvcc::expr_throws(
+          uv_tcp_bind(&server_->raw_->tcp, ep_->sockAddress(), 0), true);
+      int size = sizeof(AnyRawSocketEndpoint);
+      uv_tcp_getsockname(&server_->raw_->tcp, ep_->_someRaw(), &size);
+      server_->listen(backlog_, [this](uv_stream_t *, int status) {
+        _receive(status);
+      });
+      if (_isAdmissionEnabled()) loop.monitor();
+    } catch (const uvcc::Exception &) {
+      server_.reset();
+      _update(State::kFailed);
+      throw;
+    }
+    _update(State::kReady);
+  }
 
   std::uint16_t port() const _NOEXCEPT { return ep_->port(); }
 
-  void cancel() {}
+  void cancel() {
+    if (!server_) return;
+    if (rechecking_) loop_->throttle().cancel(this);
+    rechecking_ = pending_ = false;
+    _closeIdle();
+    server_.reset();
+    _update(State::kCancelled);
+  }
 
   const EventLoop &loop() const _NOEXCEPT { return *loop_; }
 
   Parameters *parameters() const _NOEXCEPT { return params_.get(); }
 
+  State state() const _NOEXCEPT { return state_; }
+
+  int backlog() const _NOEXCEPT { return backlog_; }
+
+  void setBacklog(int backlog) _NOEXCEPT { backlog_ = backlog; }
+
+  const AdmissionOptions &admission() const _NOEXCEPT { return admission_; }
+
+  void setAdmission(const AdmissionOptions &options) {
+    admission_ = options;
+    if (server_ && _isAdmissionEnabled()) loop_->monitor();
+  }
+
+  /// Accepts at most `batch` connections per loop iteration and leaves the
+  /// rest for the next one, so a connection storm cannot take whole
+  /// iterations from established connections. Zero accepts without limit.
+  void setAcceptBatch(std::size_t batch) _NOEXCEPT { accept_batch_ = batch; }
+
+  std::size_t acceptBatch() const _NOEXCEPT { return accept_batch_; }
+
+  std::uint64_t acceptedCount() const _NOEXCEPT { return accepted_count_; }
+
+  /// Times a ready connection was left for a later iteration.
+  std::uint64_t deferredCount() const _NOEXCEPT { return deferred_count_; }
+
+  /// Connections accepted per second over the last whole second.
+  std::uint64_t acceptRate() const _NOEXCEPT {
+    return loop_ && uv_now(loop_->raw_.get()) - rate_start_ >= 2000
+               ? 0
+               : accept_rate_;
+  }
+
+  /// Connections waiting to be accepted: the kernel's accept queue where
+  /// it is reported, otherwise whether one is being held back.
+  std::size_t acceptQueueDepth() const _NOEXCEPT {
+    if (!server_) return 0;
+#if defined(__linux__)
+    uv_os_fd_t fd;
+    struct tcp_info info;
+    socklen_t size = sizeof(info);
+    if (!uv_fileno(reinterpret_cast<uv_handle_t *>(&server_->raw_->tcp), &fd) &&
+        !getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &size))
+      return info.tcpi_unacked;
+#endif
+    return pending_ ? 1 : 0;
+  }
+
+  /// Connections reset while overloaded in `reject` mode.
+  std::uint64_t rejectedCount() const _NOEXCEPT { return rejected_count_; }
+
+  /// Caps the inbound bytes of all accepted connections together; applies
+  /// to connections accepted afterwards. A zero rate removes the cap; a
+  /// zero burst with a non-zero rate throws `UV_EINVAL`.
+  void setReadLimit(std::uint64_t rate, std::uint64_t burst) {
+    read_limit_ = _limit(rate, burst);
+  }
+
+  void setWriteLimit(std::uint64_t rate, std::uint64_t burst) {
+    write_limit_ = _limit(rate, burst);
+  }
+
   std::unique_ptr<std::function<void(const State &)>> stateUpdateHandler = 0;
   std::unique_ptr<std::function<void(const Connection &)>>
       newConnectionHandler = 0;
 
  private:
   std::unique_ptr<Endpoint> ep_;
-  std::unique_ptr<uvcc::EventLoop> loop_;
+  uvcc::EventLoop *loop_ = nullptr;
   std::unique_ptr<Parameters> params_;
+  std::unique_ptr<uvcc::Stream> server_;
+  int backlog_ = 128;
   State state_;
+  std::shared_ptr<uvcc::TokenBucket> read_limit_, write_limit_;
+  AdmissionOptions admission_;
+  std::uint64_t rejected_count_ = 0;
+  bool rechecking_ = false;
+  bool pending_ = false;
+  std::size_t accept_batch_ = 0;
+  std::size_t batch_accepted_ = 0;
+  uv_idle_t *idle_ = nullptr;
+  std::uint64_t accepted_count_ = 0;
+  std::uint64_t deferred_count_ = 0;
+  std::uint64_t accept_rate_ = 0;
+  std::uint64_t rate_start_ = 0;
+  std::uint64_t rate_count_ = 0;
+
+  static std::shared_ptr<uvcc::TokenBucket> _limit(std::uint64_t rate,
+                                                  std::uint64_t burst) {
+    if (!rate) return nullptr;
+    if (!burst) uvcc::expr_throws(UV_EINVAL);
+    return std::make_shared<uvcc::TokenBucket>(rate, burst);
+  }
+
+  void _update(const State &state) {
+    state_ = state;
+    if (stateUpdateHandler) (*stateUpdateHandler)(state_);
+  }
+
+  void _receive(int status) {
+    if (status < 0) return uvcc::expr_cerr(uvcc::Exception(status), UV_TCP);
+    if (_isOverloaded()) {
+      if (state_ == State::kReady) _update(State::kWaiting);
+      _recheck();
+      if (admission_.reject) return _reject();
+      // An unaccepted connection makes libuv stop polling the socket
+      // until the next accept.
+      pending_ = true;
+      return;
+    }
+    if (state_ == State::kWaiting) _update(State::kReady);
+    if (accept_batch_ && batch_accepted_ >= accept_batch_) {
+      pending_ = true;
+      ++deferred_count_;
+      return;
+    }
+    _accept();
+  }
+
+  void _accept() {
+    if (accept_batch_ && batch_accepted_++ == 0) _startIdle();
+    _count();
+    auto stream =
+        std::make_shared<uvcc::Stream>(uvcc::Stream::TransmitType::kTCP);
+    try {
+      stream->open(*loop_);
+      server_->accept(*stream);
+      if (read_limit_) stream->setSharedReadLimit(read_limit_);
+      if (write_limit_) stream->setSharedWriteLimit(write_limit_);
+    } catch (const uvcc::Exception &exception) {
+      return uvcc::expr_cerr(exception, UV_TCP);
+    }
+    if (newConnectionHandler) (*newConnectionHandler)(Connection(stream));
+  }
+
+  void _count() _NOEXCEPT {
+    ++accepted_count_;
+    auto now = uv_now(loop_->raw_.get());
+    if (now - rate_start_ >= 1000) {
+      accept_rate_ = now - rate_start_ < 2000 ? rate_count_ : 0;
+      rate_start_ = now;
+      rate_count_ = 0;
+    }
+    ++rate_count_;
+  }
+
+  /// Ends the batch on the next iteration and takes up a held connection.
+  void _startIdle() {
+    if (!idle_) {
+      idle_ = new uv_idle_t();
+      uv_idle_init(loop_->raw_.get(), idle_);
+      idle_->data = this;
+    }
+    uv_idle_start(idle_, [](uv_idle_t *handle) {
+      auto listener = static_cast<Listener *>(handle->data);
+      uv_idle_stop(handle);
+      listener->batch_accepted_ = 0;
+      if (!listener->pending_ || listener->state_ != State::kReady) return;
+      listener->pending_ = false;
+      listener->_accept();
+    });
+  }
+
+  void _closeIdle() _NOEXCEPT {
+    if (!idle_) return;
+    uv_close(reinterpret_cast<uv_handle_t *>(idle_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_idle_t *>(handle);
+    });
+    idle_ = nullptr;
+    batch_accepted_ = 0;
+  }
+
+  void _reject() {
+    uvcc::Stream stream(uvcc::Stream::TransmitType::kTCP);
+    try {
+      stream.open(*loop_);
+      server_->accept(stream);
+    } catch (const uvcc::Exception &exception) {
+      return uvcc::expr_cerr(exception, UV_TCP);
+    }
+    uv_os_fd_t fd;
+    if (!uv_fileno(reinterpret_cast<uv_handle_t *>(&stream.raw_->tcp), &fd)) {
+      struct linger option = {1, 0};
+      setsockopt(fd, SOL_SOCKET, SO_LINGER, &option, sizeof(option));
+    }
+    ++rejected_count_;
+  }
+
+  bool _isAdmissionEnabled() const _NOEXCEPT {
+    return admission_.max_lag || admission_.min_idle_ratio > 0;
+  }
+
+  bool _isOverloaded() {
+    if (!_isAdmissionEnabled()) return false;
+    auto &monitor = loop_->monitor();
+    auto waiting = state_ == State::kWaiting;
+    auto max_lag = waiting ? admission_.max_lag / 2 : admission_.max_lag;
+    auto min_idle_ratio =
+        waiting ? std::min(1.0, (1 + admission_.min_idle_ratio) / 2)
+                : admission_.min_idle_ratio;
+    return (admission_.max_lag && monitor.lag() > max_lag) ||
+           (admission_.min_idle_ratio > 0 &&
+            monitor.idleRatio() < min_idle_ratio);
+  }
+
+  void _recheck() {
+    if (rechecking_) return;
+    rechecking_ = true;
+    loop_->throttle().defer(this, admission_.interval, [this] {
+      rechecking_ = false;
+      if (_isOverloaded()) return _recheck();
+      _update(State::kReady);
+      if (!pending_) return;
+      pending_ = false;
+      _accept();
+    });
+  }
 };
 
 }  // namespace network
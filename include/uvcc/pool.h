@@ -0,0 +1,155 @@
+/// MIT License
+///
+/// uvcc/pool.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <uv.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Single-threaded free list of fixed-size objects. Storage released back to
+/// the pool is kept for reuse up to `max_cached` entries.
+template <typename T>
+class ObjectPool {
+ public:
+  explicit ObjectPool(std::size_t max_cached = 1024,
+                      AllocationTracker::Subsystem subsystem =
+                          AllocationTracker::Subsystem::kRequests) _NOEXCEPT
+      : max_cached_(max_cached),
+        subsystem_(subsystem) {}
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+  ~ObjectPool() {
+    while (free_) {
+      auto node = free_;
+      free_ = node->next;
+      AllocationTracker::deallocate(node);
+    }
+  }
+
+  template <typename... Ts>
+  T *acquire(Ts &&...params) {
+    void *storage;
+    if (free_) {
+      storage = free_;
+      free_ = free_->next;
+      --cached_;
+    } else {
+      storage = AllocationTracker::allocate(subsystem_, sizeof(Node));
+    }
+    return new (storage) T(std::forward<Ts>(params)...);
+  }
+
+  void release(T *object) _NOEXCEPT {
+    if (!object) return;
+    object->~T();
+    if (cached_ >= max_cached_) return AllocationTracker::deallocate(object);
+    auto node = reinterpret_cast<Node *>(object);
+    node->next = free_;
+    free_ = node;
+    ++cached_;
+  }
+
+  std::size_t cachedCount() const _NOEXCEPT { return cached_; }
+
+ private:
+  union Node {
+    Node *next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  Node *free_ = nullptr;
+  std::size_t cached_ = 0;
+  std::size_t max_cached_;
+  AllocationTracker::Subsystem subsystem_;
+};
+
+/// Single-threaded pool of `uv_buf_t` blocks of one size, for read buffers
+/// and outgoing frames.
+class BufferPool {
+ public:
+  explicit BufferPool(std::size_t block_size = 64 * 1024,
+                      std::size_t max_cached = 256) _NOEXCEPT
+      : block_size_(block_size < sizeof(void *) ? sizeof(void *) : block_size),
+        max_cached_(max_cached) {}
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+  ~BufferPool() {
+    while (free_) {
+      auto block = free_;
+      free_ = *reinterpret_cast<char **>(block);
+      AllocationTracker::deallocate(block);
+    }
+  }
+
+  uv_buf_t acquire() {
+    char *block = free_;
+    if (block) {
+      free_ = *reinterpret_cast<char **>(block);
+      --cached_;
+    } else {
+      block = static_cast<char *>(AllocationTracker::allocate(
+          AllocationTracker::Subsystem::kBuffers, block_size_));
+    }
+    return uv_buf_init(block, static_cast<unsigned int>(block_size_));
+  }
+
+  /// Returns a block obtained from `acquire()`; `buf.len` may have been
+  /// shortened since.
+  void release(const uv_buf_t &buf) _NOEXCEPT {
+    if (!buf.base) return;
+    if (cached_ >= max_cached_) return AllocationTracker::deallocate(buf.base);
+    *reinterpret_cast<char **>(buf.base) = free_;
+    free_ = buf.base;
+    ++cached_;
+  }
+
+  std::size_t blockSize() const _NOEXCEPT { return block_size_; }
+
+  std::size_t cachedCount() const _NOEXCEPT { return cached_; }
+
+ private:
+  char *free_ = nullptr;
+  std::size_t cached_ = 0;
+  std::size_t block_size_;
+  std::size_t max_cached_;
+};
+
+using RequestPool = ObjectPool<uv_any_req>;
+
+}  // namespace uvcc
+
+#endif  // POOL_H
@@ -0,0 +1,442 @@
+/// MIT License
+///
+/// uvcc/prefork.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef PREFORK_H
+#define PREFORK_H
+
+#include <signal.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event-loop.h"
+#include "network.h"
+#include "utilities.h"
+
+extern char **environ;
+
+namespace uvcc {
+
+/// Master side of a prefork server. The master binds the listening socket
+/// once and hands it to every worker over an IPC pipe on the worker's fd 3.
+/// Crashed workers are replaced; SIGHUP starts a new generation of workers
+/// and asks the previous one to drain with SIGTERM (SIGKILL after
+/// `drain_timeout`). The master must outlive the loop run that serves it.
+class PreforkMaster {
+ public:
+  static constexpr const char *kWorkerEnvironment = "UVCC_PREFORK_WORKER";
+
+  struct Options {
+    /// Worker executable; defaults to the running program.
+    std::string file;
+    /// Worker argv, `args[0]` included; defaults to `{file}`.
+    std::vector<std::string> args;
+    /// Number of workers; 0 means one per available CPU.
+    std::size_t workers = 0;
+    std::uint64_t restart_delay = 1000;
+    std::uint64_t drain_timeout = 30000;
+  };
+
+  PreforkMaster(uvcc::EventLoop &loop, const network::Endpoint &endpoint)
+      : PreforkMaster(loop, endpoint, Options()) {}
+  PreforkMaster(uvcc::EventLoop &loop, const network::Endpoint &endpoint,
+                const Options &options)
+      : loop_(loop.raw_.get()), options_(options) {
+    if (options_.file.empty()) {
+      char path[4096];
+      std::size_t size = sizeof(path);
+      uvcc::expr_throws(uv_exepath(path, &size));
+      options_.file.assign(path, size);
+    }
+    if (options_.args.empty()) options_.args.push_back(options_.file);
+    if (!options_.workers) {
+      auto count = std::thread::hardware_concurrency();
+      options_.workers = count ? count : 1;
+    }
+    for (char **env = environ; env && *env; ++env)
+      environment_.push_back(*env);
+    environment_.push_back(std::string(kWorkerEnvironment) + "=1");
+
+    server_ = new uv_tcp_t();
+    uvcc::expr_throws(uv_tcp_init(loop_, server_));
+    server_->data = this;
+    uvcc::expr_throws(uv_tcp_bind(server_, endpoint.sockAddress(), 0));
+    reloader_ = _newHandle<uv_signal_t>(uv_signal_init);
+    respawner_ = _newHandle<uv_timer_t>(uv_timer_init);
+    drainer_ = _newHandle<uv_timer_t>(uv_timer_init);
+  }
+  PreforkMaster(const PreforkMaster &) = delete;
+  PreforkMaster &operator=(const PreforkMaster &) = delete;
+  ~PreforkMaster() {
+    for (auto worker : workers_) {
+      worker->master = nullptr;
+      uv_process_kill(&worker->process, SIGTERM);
+      _closeWorker(worker);
+    }
+    workers_.clear();
+    _closeListeners();
+  }
+
+  /// Spawns the first generation and starts listening for SIGHUP.
+  void start() {
+    uvcc::expr_throws(uv_signal_start(
+        reloader_,
+        [](uv_signal_t *handle, int) {
+          static_cast<PreforkMaster *>(handle->data)->reload();
+        },
+        SIGHUP));
+    _spawnGeneration();
+  }
+
+  /// Brings up a new generation of workers, then drains the old one.
+  void reload() {
+    if (stopping_) return;
+    for (auto worker : workers_)
+      if (!worker->draining) {
+        worker->draining = true;
+        uv_process_kill(&worker->process, SIGTERM);
+      }
+    ++generation_;
+    _spawnGeneration();
+    uv_timer_start(
+        drainer_,
+        [](uv_timer_t *handle) {
+          for (auto worker : static_cast<PreforkMaster *>(handle->data)->workers_)
+            if (worker->draining) uv_process_kill(&worker->process, SIGKILL);
+        },
+        options_.drain_timeout, 0);
+  }
+
+  /// Drains every worker; the listening socket is closed once all exited.
+  void stop() _NOEXCEPT {
+    if (stopping_) return;
+    stopping_ = true;
+    uv_signal_stop(reloader_);
+    uv_timer_stop(respawner_);
+    for (auto worker : workers_) {
+      worker->draining = true;
+      uv_process_kill(&worker->process, SIGTERM);
+    }
+    uv_timer_start(
+        drainer_,
+        [](uv_timer_t *handle) {
+          for (auto worker : static_cast<PreforkMaster *>(handle->data)->workers_)
+            uv_process_kill(&worker->process, SIGKILL);
+        },
+        options_.drain_timeout, 0);
+    if (workers_.empty()) _closeListeners();
+  }
+
+  std::size_t workerCount() const _NOEXCEPT { return workers_.size(); }
+
+  std::size_t generation() const _NOEXCEPT { return generation_; }
+
+  static bool isWorker() _NOEXCEPT {
+    return std::getenv(kWorkerEnvironment) != nullptr;
+  }
+
+ private:
+  struct Worker {
+    uv_process_t process;
+    uv_pipe_t channel;
+    uv_write_t handoff;
+    PreforkMaster *master;
+    std::size_t generation;
+    bool draining;
+    int closing;
+  };
+
+  uv_loop_t *loop_;
+  Options options_;
+  std::vector<std::string> environment_;
+  uv_tcp_t *server_ = nullptr;
+  uv_signal_t *reloader_ = nullptr;
+  uv_timer_t *respawner_ = nullptr;
+  uv_timer_t *drainer_ = nullptr;
+  std::vector<Worker *> workers_;
+  std::size_t generation_ = 0;
+  bool stopping_ = false;
+
+  template <typename T, typename Initializer>
+  T *_newHandle(Initializer initializer) {
+    auto handle = new T();
+    uvcc::expr_throws(initializer(loop_, handle));
+    handle->data = this;
+    return handle;
+  }
+
+  template <typename T>
+  static void _closeHandle(T *&handle) _NOEXCEPT {
+    if (!handle) return;
+    uv_close(reinterpret_cast<uv_handle_t *>(handle), [](uv_handle_t *handle) {
+      delete reinterpret_cast<T *>(handle);
+    });
+    handle = nullptr;
+  }
+
+  void _closeListeners() _NOEXCEPT {
+    _closeHandle(server_);
+    _closeHandle(reloader_);
+    _closeHandle(respawner_);
+    _closeHandle(drainer_);
+  }
+
+  void _spawnGeneration() {
+    std::size_t live = 0;
+    for (auto worker : workers_)
+      if (!worker->draining) ++live;
+    while (live++ < options_.workers) _spawn();
+  }
+
+  void _spawn() {
+    auto worker = new Worker();
+    worker->master = this;
+    worker->generation = generation_;
+    uv_pipe_init(loop_, &worker->channel, 1);
+    worker->channel.data = worker;
+
+    std::vector<char *> args, env;
+    for (auto &arg : options_.args) args.push_back(&arg[0]);
+    args.push_back(nullptr);
+    for (auto &var : environment_) env.push_back(&var[0]);
+    env.push_back(nullptr);
+
+    uv_stdio_container_t stdio[4];
+    for (int fd = 0; fd < 3; ++fd) {
+      stdio[fd].flags = UV_INHERIT_FD;
+      stdio[fd].data.fd = fd;
+    }
+    stdio[3].flags = static_cast<uv_stdio_flags>(
+        UV_CREATE_PIPE | UV_READABLE_PIPE | UV_WRITABLE_PIPE);
+    stdio[3].data.stream = reinterpret_cast<uv_stream_t *>(&worker->channel);
+
+    uv_process_options_t options = {};
+    options.file = options_.file.c_str();
+    options.args = args.data();
+    options.env = env.data();
+    options.stdio = stdio;
+    options.stdio_count = 4;
+    options.exit_cb = [](uv_process_t *process, std::int64_t status,
+                         int signal) {
+      auto worker = static_cast<Worker *>(process->data);
+      if (worker->master) worker->master->_exited(worker, status, signal);
+    };
+    worker->process.data = worker;
+    auto err = uv_spawn(loop_, &worker->process, &options);
+    if (err) {
+      // uv_spawn initialises the process handle even when it fails, so it is
+      // closed alongside the channel.
+      _closeWorker(worker);
+      uvcc::expr_cerr(uvcc::Exception(err), UV_PROCESS);
+      _scheduleRespawn();
+      return;
+    }
+    workers_.push_back(worker);
+
+    static char token = 'L';
+    auto buf = uv_buf_init(&token, 1);
+    worker->handoff.data = worker;
+    err = uv_write2(&worker->handoff,
+                    reinterpret_cast<uv_stream_t *>(&worker->channel), &buf, 1,
+                    reinterpret_cast<uv_stream_t *>(server_),
+                    [](uv_write_t *, int status) {
+                      if (status && status != UV_ECANCELED)
+                        uvcc::expr_cerr(uvcc::Exception(status),
+                                        UV_NAMED_PIPE);
+                    });
+    if (err) {
+      uvcc::expr_cerr(uvcc::Exception(err), UV_NAMED_PIPE);
+      uv_process_kill(&worker->process, SIGTERM);
+    }
+  }
+
+  void _exited(Worker *worker, std::int64_t status, int signal) {
+    for (auto it = workers_.begin(); it != workers_.end(); ++it)
+      if (*it == worker) {
+        workers_.erase(it);
+        break;
+      }
+    auto crashed = !worker->draining;
+    if (crashed && (status || signal))
+      uvcc::Logger::shared().log(uvcc::Logger::Level::kWarning, 0,
+                                 UV_PROCESS, "prefork worker crashed");
+    _closeWorker(worker);
+    if (stopping_) {
+      if (workers_.empty()) _closeListeners();
+    } else if (crashed) {
+      _scheduleRespawn();
+    } else if (std::none_of(workers_.begin(), workers_.end(),
+                            [](Worker *worker) { return worker->draining; })) {
+      uv_timer_stop(drainer_);
+    }
+  }
+
+  void _scheduleRespawn() _NOEXCEPT {
+    if (stopping_ || !respawner_ || uv_is_active(reinterpret_cast<uv_handle_t *>(respawner_)))
+      return;
+    uv_timer_start(
+        respawner_,
+        [](uv_timer_t *handle) {
+          auto master = static_cast<PreforkMaster *>(handle->data);
+          try {
+            master->_spawnGeneration();
+          } catch (const uvcc::Exception &exception) {
+            uvcc::expr_cerr(exception, UV_PROCESS);
+          }
+        },
+        options_.restart_delay, 0);
+  }
+
+  static void _closeWorker(Worker *worker) _NOEXCEPT {
+    worker->closing = 2;
+    auto closed = [](uv_handle_t *handle) {
+      auto worker = static_cast<Worker *>(handle->data);
+      if (--worker->closing == 0) delete worker;
+    };
+    uv_close(reinterpret_cast<uv_handle_t *>(&worker->process), closed);
+    uv_close(reinterpret_cast<uv_handle_t *>(&worker->channel), closed);
+  }
+};
+
+/// Worker side of a prefork server: receives the listening socket from the
+/// master over fd 3 and listens on it. On SIGTERM it stops accepting, runs
+/// the draining block and releases its own handles so the loop can exit
+/// once the remaining connections are done.
+class PreforkWorker {
+ public:
+  using ConnectingRawCompletionBlock = uvcc::RawCompletionBlock<uv_connection_cb>;
+  using ConnectingCompletionBlock = std::function<ConnectingRawCompletionBlock>;
+  using DrainingCompletionBlock = std::function<void()>;
+
+  explicit PreforkWorker(uvcc::EventLoop &loop, int backlog = 128)
+      : loop_(loop.raw_.get()), backlog_(backlog) {}
+  PreforkWorker(const PreforkWorker &) = delete;
+  PreforkWorker &operator=(const PreforkWorker &) = delete;
+  ~PreforkWorker() { drain(); }
+
+  /// Waits for the listening socket; `block` is the listener's connection
+  /// callback and is expected to `uv_accept` from the stream it is given.
+  void start(ConnectingCompletionBlock &&block,
+             DrainingCompletionBlock &&draining = {}) {
+    connecting_ = std::move(block);
+    draining_ = std::move(draining);
+    channel_ = new uv_pipe_t();
+    uvcc::expr_throws(uv_pipe_init(loop_, channel_, 1));
+    channel_->data = this;
+    uvcc::expr_throws(uv_pipe_open(channel_, 3));
+    uvcc::expr_throws(uv_read_start(
+        reinterpret_cast<uv_stream_t *>(channel_),
+        [](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+          static char token[16];
+          *buf = uv_buf_init(token, sizeof(token));
+        },
+        [](uv_stream_t *stream, ssize_t nread, const uv_buf_t *) {
+          static_cast<PreforkWorker *>(stream->data)->_received(nread);
+        }));
+    terminator_ = new uv_signal_t();
+    uvcc::expr_throws(uv_signal_init(loop_, terminator_));
+    terminator_->data = this;
+    uvcc::expr_throws(uv_signal_start(
+        terminator_,
+        [](uv_signal_t *handle, int) {
+          static_cast<PreforkWorker *>(handle->data)->drain();
+        },
+        SIGTERM));
+  }
+
+  /// Stops accepting and releases the worker's handles.
+  void drain() _NOEXCEPT {
+    if (drained_) return;
+    drained_ = true;
+    _close(server_);
+    _close(channel_);
+    _close(terminator_);
+    if (draining_) draining_();
+  }
+
+  bool isListening() const _NOEXCEPT { return server_ != nullptr; }
+
+ private:
+  uv_loop_t *loop_;
+  int backlog_;
+  uv_pipe_t *channel_ = nullptr;
+  uv_tcp_t *server_ = nullptr;
+  uv_signal_t *terminator_ = nullptr;
+  ConnectingCompletionBlock connecting_;
+  DrainingCompletionBlock draining_;
+  bool drained_ = false;
+
+  template <typename T>
+  static void _close(T *&handle) _NOEXCEPT {
+    if (!handle) return;
+    uv_close(reinterpret_cast<uv_handle_t *>(handle), [](uv_handle_t *handle) {
+      delete reinterpret_cast<T *>(handle);
+    });
+    handle = nullptr;
+  }
+
+  void _received(ssize_t nread) {
+    if (nread < 0) {
+      if (nread != UV_EOF)
+        uvcc::expr_cerr(uvcc::Exception(static_cast<int>(nread)),
+                        UV_NAMED_PIPE);
+      return drain();
+    }
+    while (uv_pipe_pending_count(channel_) > 0) {
+      if (uv_pipe_pending_type(channel_) != UV_TCP || server_) {
+        uvcc::expr_cerr(uvcc::Exception(UV_EINVAL), UV_NAMED_PIPE);
+        return drain();
+      }
+      server_ = new uv_tcp_t();
+      uv_tcp_init(loop_, server_);
+      server_->data = this;
+      auto err = uv_accept(reinterpret_cast<uv_stream_t *>(channel_),
+                           reinterpret_cast<uv_stream_t *>(server_));
+      if (!err)
+        err = uv_listen(reinterpret_cast<uv_stream_t *>(server_), backlog_,
+                        [](uv_stream_t *server, int status) {
+                          auto worker =
+                              static_cast<PreforkWorker *>(server->data);
+                          if (worker->connecting_)
+                            worker->connecting_(server, status);
+                        });
+      if (err) {
+        uvcc::expr_cerr(uvcc::Exception(err), UV_TCP);
+        return drain();
+      }
+    }
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // PREFORK_H
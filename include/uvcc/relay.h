@@ -0,0 +1,325 @@
+/// MIT License
+///
+/// uvcc/relay.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <functional>
+
+#include "pool.h"
+#include "stream.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Pairs two connected streams and copies bytes both ways until each side
+/// has sent EOF. On Linux the bytes move with `splice(2)` through a kernel
+/// pipe per direction and never reach user space; elsewhere, or when the
+/// streams cannot be spliced, they are read into pooled buffers and written
+/// back out. EOF on one side is forwarded as a write shutdown on the other.
+/// Both streams belong to the relay between `start()` and the finishing
+/// block, and since splice cannot suppress SIGPIPE the process should
+/// ignore it.
+class Relay {
+ public:
+  using FinishingCompletionBlock = std::function<void(int)>;
+
+  Relay(uvcc::Stream &first, uvcc::Stream &second,
+        uvcc::BufferPool *buffers = nullptr)
+      : context_(std::make_shared<Context>()) {
+    context_->streams[0] = &first;
+    context_->streams[1] = &second;
+    context_->buffers = buffers ? buffers : &context_->owned_buffers;
+  }
+  Relay(const Relay &) = delete;
+  Relay &operator=(const Relay &) = delete;
+  ~Relay() {
+    context_->finishing_block = nullptr;
+    _teardown(*context_);
+  }
+
+  /// `block` gets 0 once both directions have shut down, or the first error.
+  void start(FinishingCompletionBlock &&block) {
+    auto &context = *context_;
+    if (context.started) uvcc::expr_throws(UV_EALREADY);
+    context.started = true;
+    context.finishing_block = std::move(block);
+    for (auto stream : context.streams) stream->stopReading();
+#ifdef __linux__
+    if (_splice(context)) return;
+#endif
+    _copy(context_);
+  }
+
+  bool isSpliced() const _NOEXCEPT { return context_->spliced; }
+
+  /// Bytes relayed from the first stream to the second.
+  std::uint64_t forwardedBytes() const _NOEXCEPT {
+    return context_->directions[0].bytes;
+  }
+
+  /// Bytes relayed from the second stream to the first.
+  std::uint64_t returnedBytes() const _NOEXCEPT {
+    return context_->directions[1].bytes;
+  }
+
+ private:
+  static const std::size_t kChunkSize = 64 * 1024;
+  static const std::size_t kHighWater = 256 * 1024;
+
+  struct Direction {
+    int pipe[2] = {-1, -1};
+    std::size_t buffered = 0;
+    std::uint64_t bytes = 0;
+    bool eof = false;
+    bool shut = false;
+    bool paused = false;
+  };
+
+  struct Context {
+    uvcc::Stream *streams[2];
+    Direction directions[2];
+    int fds[2] = {-1, -1};
+    uv_poll_t *polls[2] = {nullptr, nullptr};
+    uvcc::BufferPool owned_buffers{kChunkSize};
+    uvcc::BufferPool *buffers;
+    FinishingCompletionBlock finishing_block;
+    bool started = false;
+    bool spliced = false;
+    bool finished = false;
+  };
+
+  std::shared_ptr<Context> context_;
+
+  static void _finish(Context &context, int status) {
+    if (context.finished) return;
+    _teardown(context);
+    auto block = std::move(context.finishing_block);
+    if (block) block(status);
+  }
+
+  static void _teardown(Context &context) _NOEXCEPT {
+    if (context.finished || !context.started) return;
+    context.finished = true;
+    for (int i = 0; i < 2; ++i) {
+      if (!context.spliced) context.streams[i]->stopReading();
+      if (context.polls[i]) {
+        uv_close(reinterpret_cast<uv_handle_t *>(context.polls[i]),
+                 [](uv_handle_t *handle) {
+                   delete reinterpret_cast<uv_poll_t *>(handle);
+                 });
+        context.polls[i] = nullptr;
+      }
+      if (context.fds[i] >= 0) ::close(context.fds[i]);
+      for (auto &fd : context.directions[i].pipe)
+        if (fd >= 0) ::close(fd);
+    }
+  }
+
+#ifdef __linux__
+  /// Sets up splicing; false leaves nothing behind for the buffered path.
+  static bool _splice(Context &context) {
+    for (int i = 0; i < 2; ++i) {
+      uv_os_fd_t fd;
+      auto handle =
+          reinterpret_cast<uv_handle_t *>(context.streams[i]->_someStream());
+      if (uv_fileno(handle, &fd) ||
+          (context.fds[i] = ::fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0 ||
+          ::pipe2(context.directions[i].pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+        return _unsplice(context);
+    }
+    auto loop = context.streams[0]->_someStream()->loop;
+    for (int i = 0; i < 2; ++i) {
+      context.polls[i] = new uv_poll_t();
+      uv_poll_init(loop, context.polls[i], context.fds[i]);
+      context.polls[i]->data = &context;
+    }
+    context.spliced = true;
+    _update(context);
+    return true;
+  }
+
+  static bool _unsplice(Context &context) _NOEXCEPT {
+    for (int i = 0; i < 2; ++i) {
+      if (context.fds[i] >= 0) ::close(context.fds[i]);
+      context.fds[i] = -1;
+      for (auto &fd : context.directions[i].pipe) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+      }
+    }
+    return false;
+  }
+
+  static void _update(Context &context) {
+    for (int i = 0; i < 2; ++i) {
+      auto &outgoing = context.directions[i];
+      auto &incoming = context.directions[1 - i];
+      int events = 0;
+      if (!outgoing.eof && !outgoing.buffered) events |= UV_READABLE;
+      if (incoming.buffered) events |= UV_WRITABLE;
+      if (!events) {
+        uv_poll_stop(context.polls[i]);
+        continue;
+      }
+      auto err = uv_poll_start(
+          context.polls[i], events,
+          [](uv_poll_t *handle, int status, int events) {
+            auto &context = *static_cast<Context *>(handle->data);
+            auto i = handle == context.polls[0] ? 0 : 1;
+            if (status < 0) return _finish(context, status);
+            if (events & UV_READABLE) status = _pump(context, i);
+            if (!status && events & UV_WRITABLE) status = _pump(context, 1 - i);
+            if (status < 0) return _finish(context, status);
+            auto &directions = context.directions;
+            if (directions[0].shut && directions[1].shut)
+              return _finish(context, 0);
+            _update(context);
+          });
+      if (err) return _finish(context, err);
+    }
+  }
+
+  /// Moves what is available from stream `i` to its peer through the pipe.
+  static int _pump(Context &context, int i) _NOEXCEPT {
+    auto &direction = context.directions[i];
+    auto source = context.fds[i], sink = context.fds[1 - i];
+    for (int round = 0; round < 16; ++round) {
+      if (!direction.eof && !direction.buffered) {
+        auto n = ::splice(source, nullptr, direction.pipe[1], nullptr,
+                          kChunkSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+          direction.buffered = static_cast<std::size_t>(n);
+        else if (n == 0)
+          direction.eof = true;
+        else if (errno != EAGAIN)
+          return -errno;
+      }
+      while (direction.buffered) {
+        auto n = ::splice(direction.pipe[0], nullptr, sink, nullptr,
+                          direction.buffered,
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n < 0) {
+          if (errno == EAGAIN) break;
+          return -errno;
+        }
+        direction.buffered -= static_cast<std::size_t>(n);
+        direction.bytes += static_cast<std::uint64_t>(n);
+      }
+      if (direction.eof || direction.buffered) break;
+    }
+    if (direction.eof && !direction.buffered && !direction.shut) {
+      direction.shut = true;
+      if (::shutdown(sink, SHUT_WR) < 0 && errno != ENOTCONN) return -errno;
+    }
+    return 0;
+  }
+#endif
+
+  static void _copy(const std::shared_ptr<Context> &context) {
+    for (int i = 0; i < 2; ++i) {
+      auto err = _read(context, i);
+      if (err) return _finish(*context, err);
+    }
+  }
+
+  static int _read(const std::shared_ptr<Context> &context, int i) {
+    auto &source = *context->streams[i];
+    std::weak_ptr<Context> weak = context;
+    context->directions[i].paused = false;
+    try {
+      source.startReading(
+          [weak](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+            auto context = weak.lock();
+            *buf = context ? context->buffers->acquire() : uv_buf_init(nullptr, 0);
+          },
+          [weak, i](uv_stream_t *, ssize_t nread, const uv_buf_t *buf) {
+            auto context = weak.lock();
+            if (!context) return;
+            _received(context, i, nread, *buf);
+          });
+    } catch (const uvcc::Exception &exception) {
+      return exception.rawCode();
+    }
+    return 0;
+  }
+
+  static void _received(const std::shared_ptr<Context> &context, int i,
+                        ssize_t nread, uv_buf_t buf) {
+    auto &direction = context->directions[i];
+    auto &sink = *context->streams[1 - i];
+    if (nread <= 0) {
+      context->buffers->release(buf);
+      if (nread == 0) return;
+      if (nread != UV_EOF) return _finish(*context, static_cast<int>(nread));
+      direction.eof = true;
+      context->streams[i]->stopReading();
+      try {
+        sink.shutdown([context, i](uv_shutdown_t *, int status) {
+          context->directions[i].shut = true;
+          if (status < 0) return _finish(*context, status);
+          if (context->directions[1 - i].shut) _finish(*context, 0);
+        });
+      } catch (const uvcc::Exception &exception) {
+        _finish(*context, exception.rawCode());
+      }
+      return;
+    }
+    buf.len = static_cast<decltype(buf.len)>(nread);
+    try {
+      sink.write(buf, [context, i, buf](uv_write_t *, int status) {
+        context->buffers->release(buf);
+        if (context->finished) return;
+        if (status < 0) return _finish(*context, status);
+        auto &direction = context->directions[i];
+        direction.bytes += buf.len;
+        auto &sink = *context->streams[1 - i];
+        if (direction.paused && sink.writeQueueSize() < kHighWater / 2) {
+          auto err = _read(context, i);
+          if (err) _finish(*context, err);
+        }
+      });
+    } catch (const uvcc::Exception &exception) {
+      context->buffers->release(buf);
+      return _finish(*context, exception.rawCode());
+    }
+    if (sink.writeQueueSize() >= kHighWater) {
+      direction.paused = true;
+      context->streams[i]->stopReading();
+    }
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // RELAY_H
@@ -84,9 +84,10 @@ class Request : virtual protected BaseObject<uv_req_t, uv_any_req> {
         raw_->req = decltype(raw_->req)();
         break;
       default:
-        raw_ = uvcc::make_unique<Self>();
+        raw_ = _makeRaw();
         break;
     }
+    _someRaw()->type = _rawType(type);
   }
   Request(const Self &self) : BaseObject<uv_req_t, uv_any_req>(self) {}
   Request(Self &&self) _NOEXCEPT
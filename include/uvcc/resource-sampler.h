@@ -0,0 +1,186 @@
+/// MIT License
+///
+/// uvcc/resource-sampler.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef RESOURCESAMPLER_H
+#define RESOURCESAMPLER_H
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <cstdio>
+#include <deque>
+#include <functional>
+
+#include "event-loop.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Periodically records the process's resident memory, open descriptors
+/// and the loop's live handles, for spotting leaks over long runs. Growth
+/// is measured from a baseline, the first sample unless reset after
+/// warm-up. The timer does not keep the loop alive.
+class ResourceSampler {
+ public:
+  struct Sample {
+    std::uint64_t time = 0;
+    std::size_t rss = 0;
+    std::size_t fds = 0;
+    std::size_t handles = 0;
+  };
+
+  /// Growth allowed over the baseline; 0 leaves a measure unchecked.
+  struct Thresholds {
+    std::size_t rss = 0;
+    std::size_t fds = 0;
+    std::size_t handles = 0;
+  };
+
+  using SamplingCompletionBlock = std::function<void(const Sample &)>;
+
+  ResourceSampler(uvcc::EventLoop &loop, std::uint64_t interval,
+                  std::size_t capacity = 1024)
+      : timer_(new uv_timer_t()), capacity_(capacity ? capacity : 1) {
+    uv_timer_init(loop.raw_.get(), timer_);
+    timer_->data = this;
+    uv_unref(reinterpret_cast<uv_handle_t *>(timer_));
+    uv_timer_start(timer_,
+                   [](uv_timer_t *handle) {
+                     static_cast<ResourceSampler *>(handle->data)->sample();
+                   },
+                   interval, interval);
+  }
+  ResourceSampler(const ResourceSampler &) = delete;
+  ResourceSampler &operator=(const ResourceSampler &) = delete;
+  ~ResourceSampler() {
+    uv_close(reinterpret_cast<uv_handle_t *>(timer_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_timer_t *>(handle);
+    });
+  }
+
+  /// Takes a sample now, besides the periodic ones.
+  const Sample &sample() {
+    Sample sample;
+    sample.time = uv_now(timer_->loop);
+    sample.rss = residentSize();
+    sample.fds = openDescriptorCount();
+    sample.handles = _handleCount();
+    if (!has_baseline_) {
+      baseline_ = sample;
+      has_baseline_ = true;
+    }
+    samples_.push_back(sample);
+    if (samples_.size() > capacity_) samples_.pop_front();
+    if (sampleHandler) sampleHandler(samples_.back());
+    return samples_.back();
+  }
+
+  /// Makes the next sample the baseline.
+  void resetBaseline() _NOEXCEPT { has_baseline_ = false; }
+
+  const Sample &baseline() const _NOEXCEPT { return baseline_; }
+
+  /// The most recent samples, oldest first, at most `capacity` of them.
+  const std::deque<Sample> &samples() const _NOEXCEPT { return samples_; }
+
+  /// Whether the latest sample grew past any of `thresholds`.
+  bool exceeds(const Thresholds &thresholds) const _NOEXCEPT {
+    if (samples_.empty()) return false;
+    auto &latest = samples_.back();
+    return _exceeds(latest.rss, baseline_.rss, thresholds.rss) ||
+           _exceeds(latest.fds, baseline_.fds, thresholds.fds) ||
+           _exceeds(latest.handles, baseline_.handles, thresholds.handles);
+  }
+
+  /// Resident set size in bytes; the peak where the current one is not
+  /// available.
+  static std::size_t residentSize() _NOEXCEPT {
+#if defined(__linux__)
+    if (auto file = std::fopen("/proc/self/statm", "r")) {
+      unsigned long size = 0, resident = 0;
+      auto read = std::fscanf(file, "%lu %lu", &size, &resident);
+      std::fclose(file);
+      if (read == 2)
+        return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) return 0;
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+  }
+
+  static std::size_t openDescriptorCount() _NOEXCEPT {
+#if defined(__linux__) || defined(__APPLE__)
+#if defined(__linux__)
+    auto dir = opendir("/proc/self/fd");
+#else
+    auto dir = opendir("/dev/fd");
+#endif
+    if (dir) {
+      std::size_t count = 0;
+      while (auto entry = readdir(dir))
+        if (entry->d_name[0] != '.') ++count;
+      closedir(dir);
+      return count ? count - 1 : 0;
+    }
+#endif
+    return 0;
+  }
+
+  SamplingCompletionBlock sampleHandler;
+
+ private:
+  uv_timer_t *timer_;
+  std::size_t capacity_;
+  std::deque<Sample> samples_;
+  Sample baseline_;
+  bool has_baseline_ = false;
+
+  /// Handles on the loop besides the sampler's own timer.
+  std::size_t _handleCount() const _NOEXCEPT {
+    std::size_t count = 0;
+    uv_walk(timer_->loop, [](uv_handle_t *, void *arg) {
+      ++*static_cast<std::size_t *>(arg);
+    }, &count);
+    return count ? count - 1 : 0;
+  }
+
+  static bool _exceeds(std::size_t value, std::size_t base,
+                       std::size_t limit) _NOEXCEPT {
+    return limit && value > base && value - base > limit;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // RESOURCESAMPLER_H
@@ -0,0 +1,420 @@
+/// MIT License
+///
+/// uvcc/resp.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef RESP_H
+#define RESP_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+#include "stream.h"
+#include "utilities.h"
+#include "view.h"
+
+namespace uvcc {
+
+namespace resp {
+
+/// Finds line terminators. The default is libc's `memchr`, which is already
+/// vectorised and measured no slower than the hand-written SSE2 and AVX2
+/// searches; those can be selected with `setDispatch()` where supported.
+class Scanner {
+ public:
+  enum class Dispatch : int {
+    kScalar,
+    kSSE2,
+    kAVX2,
+  };
+
+  /// First "\r\n" in [begin, end), or null when there is none yet.
+  static const char *findLineEnd(const char *begin,
+                                 const char *end) _NOEXCEPT {
+    auto search = _search();
+    for (auto p = begin; p < end;) {
+      p = search(p, end);
+      if (!p || p + 1 >= end) return nullptr;
+      if (p[1] == '\n') return p;
+      ++p;
+    }
+    return nullptr;
+  }
+
+  static Dispatch dispatch() _NOEXCEPT { return _dispatch(); }
+
+  /// The best search this CPU supports.
+  static Dispatch detect() _NOEXCEPT {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Dispatch::kAVX2;
+    return Dispatch::kSSE2;
+#else
+    return Dispatch::kScalar;
+#endif
+  }
+
+  /// Selects a search, e.g. to compare paths; wider than `detect()` is
+  /// refused.
+  static bool setDispatch(const Dispatch &dispatch) _NOEXCEPT {
+    if (static_cast<int>(dispatch) > static_cast<int>(detect())) return false;
+    _dispatch() = dispatch;
+    return true;
+  }
+
+ private:
+  using Search = const char *(*)(const char *, const char *);
+
+  static Dispatch &_dispatch() _NOEXCEPT {
+    static Dispatch dispatch = Dispatch::kScalar;
+    return dispatch;
+  }
+
+  static Search _search() _NOEXCEPT {
+    switch (_dispatch()) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+      case Dispatch::kAVX2:
+        return _searchAVX2;
+      case Dispatch::kSSE2:
+        return _searchSSE2;
+#endif
+      default:
+        return _searchScalar;
+    }
+  }
+
+  static const char *_searchScalar(const char *begin,
+                                   const char *end) _NOEXCEPT {
+    return static_cast<const char *>(std::memchr(begin, '\r', end - begin));
+  }
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  static const char *_searchSSE2(const char *begin,
+                                 const char *end) _NOEXCEPT {
+    auto needle = _mm_set1_epi8('\r');
+    auto p = begin;
+    for (; p + 16 <= end; p += 16) {
+      auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+      if (mask) return p + __builtin_ctz(static_cast<unsigned int>(mask));
+    }
+    return _searchScalar(p, end);
+  }
+
+  __attribute__((target("avx2"))) static const char *_searchAVX2(
+      const char *begin, const char *end) _NOEXCEPT {
+    auto needle = _mm256_set1_epi8('\r');
+    auto p = begin;
+    for (; p + 32 <= end; p += 32) {
+      auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      auto mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+      if (mask) return p + __builtin_ctz(static_cast<unsigned int>(mask));
+    }
+    return _searchSSE2(p, end);
+  }
+#endif
+};
+
+/// One parsed command. The arguments point into the read buffer and are
+/// only valid while the command handler runs.
+class Command {
+  friend class Parser;
+
+ public:
+  std::size_t size() const _NOEXCEPT { return arguments_.size(); }
+
+  const View &operator[](std::size_t index) const _NOEXCEPT {
+    return arguments_[index];
+  }
+
+  View name() const _NOEXCEPT {
+    return arguments_.empty() ? View() : arguments_[0];
+  }
+
+  /// Whether it came as a plain line rather than a RESP array.
+  bool isInline() const _NOEXCEPT { return inline_; }
+
+ private:
+  std::vector<View> arguments_;
+  bool inline_ = false;
+};
+
+/// In-place parser for RESP arrays of bulk strings and for inline commands,
+/// one space-separated line each. Bulk payloads are skipped by length;
+/// only the short header lines are scanned.
+class Parser {
+ public:
+  static constexpr long kMalformed = -1;
+  static constexpr long kTooLarge = -2;
+
+  struct Limits {
+    std::size_t max_arguments = 1024 * 1024;
+    std::size_t max_bulk_bytes = 512 * 1024 * 1024;
+    std::size_t max_inline_bytes = 64 * 1024;
+  };
+
+  /// Where an incomplete array stopped. The bulks parsed so far stay in
+  /// the command and are also kept as offsets, in case the buffer moves
+  /// before the rest arrives.
+  struct Progress {
+    long long count = 0;
+    std::size_t offset = 0;
+    std::uintptr_t base = 0;
+    std::vector<std::pair<std::size_t, std::size_t>> arguments;
+  };
+
+  /// Parses one command from `data`. Returns the bytes it spans, 0 when
+  /// more input is needed, or `kMalformed` / `kTooLarge`. Empty lines and
+  /// empty arrays are consumed as commands without arguments.
+  static long parse(const char *data, std::size_t size, const Limits &limits,
+                    Command &command) {
+    return _parse(data, size, limits, command, nullptr);
+  }
+
+  /// Same, but an incomplete array is remembered in `progress` and the
+  /// next call, given the same `command` and the input again from the
+  /// command's first byte, resumes after its last complete bulk.
+  static long parse(const char *data, std::size_t size, const Limits &limits,
+                    Command &command, Progress &progress) {
+    auto consumed = _parse(data, size, limits, command, &progress);
+    if (consumed) progress.count = 0;
+    return consumed;
+  }
+
+ private:
+  static long _parse(const char *data, std::size_t size, const Limits &limits,
+                     Command &command, Progress *progress) {
+    auto resuming = progress && progress->count;
+    if (!resuming) command.arguments_.clear();
+    if (!size) return 0;
+    auto end = data + size;
+    if (data[0] != '*') return _parseInline(data, end, limits, command);
+    command.inline_ = false;
+
+    long long count;
+    const char *cursor;
+    if (resuming) {
+      count = progress->count;
+      cursor = data + progress->offset;
+      if (reinterpret_cast<std::uintptr_t>(data) != progress->base) {
+        command.arguments_.clear();
+        for (auto &argument : progress->arguments)
+          command.arguments_.emplace_back(data + argument.first,
+                                          argument.second);
+      }
+    } else {
+      if (progress) progress->arguments.clear();
+      cursor = data + 1;
+      auto state = _header(cursor, end, count);
+      if (state <= 0) return state ? state : 0;
+      if (count < 0) return static_cast<long>(cursor - data);
+      if (static_cast<unsigned long long>(count) > limits.max_arguments)
+        return kTooLarge;
+      // Every argument takes at least four bytes, so a bogus count cannot
+      // reserve more than the input could ever fill.
+      auto room = static_cast<std::size_t>(end - cursor) / 4;
+      command.arguments_.reserve(
+          std::min(static_cast<std::size_t>(count), room));
+    }
+    for (auto i = static_cast<long long>(command.arguments_.size());
+         i < count; ++i) {
+      auto bulk_start = cursor;
+      long long length;
+      auto state = cursor < end ? 1L : 0L;
+      if (state && *cursor++ != '$') return kMalformed;
+      if (state) state = _header(cursor, end, length);
+      if (state < 0) return state;
+      if (state && length < 0) return kMalformed;
+      if (state &&
+          static_cast<unsigned long long>(length) > limits.max_bulk_bytes)
+        return kTooLarge;
+      auto bulk = state ? static_cast<std::size_t>(length) : 0;
+      if (!state || static_cast<std::size_t>(end - cursor) < bulk + 2) {
+        if (progress) _suspend(data, bulk_start, count, command, *progress);
+        return 0;
+      }
+      if (cursor[bulk] != '\r' || cursor[bulk + 1] != '\n') return kMalformed;
+      command.arguments_.emplace_back(cursor, bulk);
+      cursor += bulk + 2;
+    }
+    return static_cast<long>(cursor - data);
+  }
+
+  /// Records the bulks parsed since the last suspension only, so that a
+  /// command arriving in many reads costs no more than one in a single read.
+  static void _suspend(const char *data, const char *cursor, long long count,
+                       const Command &command, Progress &progress) {
+    progress.count = count;
+    progress.offset = static_cast<std::size_t>(cursor - data);
+    progress.base = reinterpret_cast<std::uintptr_t>(data);
+    for (auto i = progress.arguments.size(); i < command.arguments_.size();
+         ++i)
+      progress.arguments.emplace_back(
+          static_cast<std::size_t>(command.arguments_[i].data() - data),
+          command.arguments_[i].size());
+  }
+
+  /// Reads a "<number>\r\n" header at `cursor`: 1 and advances on success,
+  /// 0 when incomplete, or an error.
+  static long _header(const char *&cursor, const char *end,
+                      long long &number) _NOEXCEPT {
+    auto line = Scanner::findLineEnd(cursor, end);
+    if (!line) return end - cursor > 20 ? kMalformed : 0;
+    auto p = cursor;
+    auto negative = p < line && *p == '-';
+    if (negative) ++p;
+    if (p == line || line - p > 18) return kMalformed;
+    number = 0;
+    for (; p < line; ++p) {
+      if (*p < '0' || *p > '9') return kMalformed;
+      number = number * 10 + (*p - '0');
+    }
+    if (negative) number = -number;
+    cursor = line + 2;
+    return 1;
+  }
+
+  static long _parseInline(const char *data, const char *end,
+                           const Limits &limits, Command &command) {
+    command.inline_ = true;
+    auto line = Scanner::findLineEnd(data, end);
+    if (!line)
+      return static_cast<std::size_t>(end - data) > limits.max_inline_bytes
+                 ? kTooLarge
+                 : 0;
+    if (static_cast<std::size_t>(line - data) > limits.max_inline_bytes)
+      return kTooLarge;
+    for (auto p = data; p < line;) {
+      while (p < line && (*p == ' ' || *p == '\t')) ++p;
+      auto start = p;
+      while (p < line && *p != ' ' && *p != '\t') ++p;
+      if (p > start) command.arguments_.emplace_back(start, p - start);
+    }
+    return static_cast<long>(line + 2 - data);
+  }
+};
+
+/// Feeds a stream's reads through `Parser` and hands each command to a
+/// handler. The stream must outlive the reader.
+class Reader {
+ public:
+  using CommandHandler = std::function<void(const Command &)>;
+  /// Told about malformed input (`Parser` codes) and read errors
+  /// (`uv_errno_t`, including `UV_EOF`); reading has stopped by then.
+  using ErrorHandler = std::function<void(long)>;
+
+  struct Options {
+    Parser::Limits limits;
+    std::size_t read_size = 16 * 1024;
+  };
+
+  Reader(uvcc::Stream &stream, CommandHandler &&handler)
+      : Reader(stream, std::move(handler), Options()) {}
+  Reader(uvcc::Stream &stream, CommandHandler &&handler,
+         const Options &options)
+      : stream_(stream), handler_(std::move(handler)), options_(options) {}
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader() { stop(); }
+
+  void start() {
+    if (reading_) return;
+    reading_ = true;
+    stream_.startReading(
+        [this](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+          if (input_.size() - length_ < options_.read_size)
+            input_.resize(length_ + options_.read_size);
+          *buf = uv_buf_init(input_.data() + length_,
+                             static_cast<unsigned int>(input_.size() - length_));
+        },
+        [this](uv_stream_t *, ssize_t nread, const uv_buf_t *) {
+          if (nread < 0) return _fail(static_cast<long>(nread));
+          length_ += static_cast<std::size_t>(nread);
+          _process();
+        });
+  }
+
+  /// Stops reading; commands already buffered are kept for `start()`.
+  void stop() _NOEXCEPT {
+    if (!reading_) return;
+    reading_ = false;
+    stream_.stopReading();
+  }
+
+  bool isReading() const _NOEXCEPT { return reading_; }
+
+  std::uint64_t commandCount() const _NOEXCEPT { return command_count_; }
+
+  ErrorHandler errorHandler;
+
+ private:
+  uvcc::Stream &stream_;
+  CommandHandler handler_;
+  Options options_;
+  std::vector<char> input_;
+  std::size_t length_ = 0;
+  Command command_;
+  Parser::Progress progress_;
+  std::uint64_t command_count_ = 0;
+  bool reading_ = false;
+
+  void _process() {
+    std::size_t offset = 0;
+    while (reading_ && offset < length_) {
+      auto consumed = Parser::parse(input_.data() + offset, length_ - offset,
+                                    options_.limits, command_, progress_);
+      if (consumed == 0) break;
+      if (consumed < 0) return _fail(consumed);
+      offset += static_cast<std::size_t>(consumed);
+      ++command_count_;
+      handler_(command_);
+    }
+    if (!offset) return;
+    std::memmove(input_.data(), input_.data() + offset, length_ - offset);
+    length_ -= offset;
+  }
+
+  void _fail(long error) {
+    stop();
+    length_ = 0;
+    progress_.count = 0;
+    if (errorHandler) errorHandler(error);
+  }
+};
+
+}  // namespace resp
+
+}  // namespace uvcc
+
+#endif  // RESP_H
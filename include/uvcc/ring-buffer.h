@@ -0,0 +1,128 @@
+/// MIT License
+///
+/// uvcc/ring-buffer.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace uvcc {
+
+/// Bounded lock-free queue (Vyukov), safe for any number of producers and
+/// consumers. Neither `push` nor `pop` ever blocks: a full ring rejects the
+/// value and an empty ring returns false.
+template <typename T>
+class RingBuffer {
+ public:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  explicit RingBuffer(std::size_t capacity)
+      : mask_(_roundUp(capacity) - 1),
+        cells_(new Cell[_roundUp(capacity)]) {
+    for (std::size_t i = 0; i <= mask_; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+  ~RingBuffer() = default;
+
+  bool push(const T &value) _NOEXCEPT {
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &cell = cells_[pos & mask_];
+      auto seq = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) -
+                  static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(T &value) _NOEXCEPT {
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &cell = cells_[pos & mask_];
+      auto seq = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) -
+                  static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool isEmpty() const _NOEXCEPT {
+    return enqueue_pos_.load(std::memory_order_acquire) ==
+           dequeue_pos_.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const _NOEXCEPT { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  const std::size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  char head_padding_[kCacheLineSize];
+  std::atomic<std::size_t> enqueue_pos_{0};
+  char tail_padding_[kCacheLineSize - sizeof(std::atomic<std::size_t>)];
+  std::atomic<std::size_t> dequeue_pos_{0};
+
+  static std::size_t _roundUp(std::size_t capacity) _NOEXCEPT {
+    std::size_t size = 2;
+    while (size < capacity) size <<= 1;
+    return size;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // RINGBUFFER_H
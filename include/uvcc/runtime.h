@@ -0,0 +1,252 @@
+/// MIT License
+///
+/// uvcc/runtime.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <uv.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event-loop.h"
+#include "pool.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Shared-nothing runtime: one `EventLoop` per worker thread, each pinned to
+/// a CPU and owning its own buffer and request pools. Loops and pools are
+/// created on their worker thread so their memory stays local to that core.
+class Runtime {
+ public:
+  struct Options {
+    /// Number of workers; 0 means one per available CPU.
+    std::size_t threads = 0;
+    /// CPUs to pin to, worker `i` uses `cpus[i % cpus.size()]`. Empty means
+    /// the CPUs this process is allowed to run on.
+    std::vector<int> cpus;
+    bool pinned = true;
+    std::size_t buffer_size = 64 * 1024;
+    std::size_t max_cached_buffers = 256;
+    std::size_t max_cached_requests = 1024;
+  };
+
+  class Worker {
+    friend class Runtime;
+
+   public:
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+
+    std::size_t index() const _NOEXCEPT { return index_; }
+
+    int cpu() const _NOEXCEPT { return cpu_; }
+
+    uvcc::EventLoop &loop() _NOEXCEPT { return *loop_; }
+
+    uvcc::BufferPool &buffers() _NOEXCEPT { return *buffers_; }
+
+    uvcc::RequestPool &requests() _NOEXCEPT { return *requests_; }
+
+   private:
+    Runtime *runtime_;
+    std::size_t index_;
+    int cpu_;
+    std::thread thread_;
+    std::unique_ptr<uvcc::EventLoop> loop_;
+    std::unique_ptr<uvcc::BufferPool> buffers_;
+    std::unique_ptr<uvcc::RequestPool> requests_;
+    uv_async_t *stopper_ = nullptr;
+
+    Worker(Runtime *runtime, std::size_t index, int cpu) _NOEXCEPT
+        : runtime_(runtime),
+          index_(index),
+          cpu_(cpu) {}
+  };
+
+  using WorkingCompletionBlock = std::function<void(Worker &)>;
+
+  Runtime() : Runtime(Options()) {}
+  explicit Runtime(const Options &options) : options_(options) {
+    if (!options_.threads) {
+      auto count = std::thread::hardware_concurrency();
+      options_.threads = count ? count : 1;
+    }
+  }
+  Runtime(const Runtime &) = delete;
+  Runtime &operator=(const Runtime &) = delete;
+  ~Runtime() {
+    stop();
+    join();
+  }
+
+  /// Spawns the workers and returns once every loop is ready. `starting`
+  /// runs on each worker thread before its loop is entered; `stopping` runs
+  /// there on `stop()` and should close the handles the worker opened. If
+  /// setting up a worker or `starting` throws, the other workers are stopped
+  /// and joined and the first exception is rethrown here.
+  void start(WorkingCompletionBlock &&starting,
+             WorkingCompletionBlock &&stopping = {}) {
+    if (!workers_.empty()) uvcc::expr_throws(UV_EALREADY);
+    starting_ = std::move(starting);
+    stopping_ = std::move(stopping);
+    auto cpus = options_.cpus.empty() ? _availableCpus() : options_.cpus;
+    for (std::size_t i = 0; i < options_.threads; ++i)
+      workers_.emplace_back(new Worker(this, i, cpus[i % cpus.size()]));
+    for (auto &worker : workers_) {
+      auto target = worker.get();
+      worker->thread_ = std::thread([this, target] { _run(*target); });
+    }
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return ready_count_ == workers_.size(); });
+      std::swap(error, error_);
+    }
+    if (!error) return;
+    stop();
+    join();
+    workers_.clear();
+    ready_count_ = 0;
+    std::rethrow_exception(error);
+  }
+
+  /// Asks every worker to run its stopping block and leave its loop.
+  void stop() _NOEXCEPT {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &worker : workers_)
+      if (worker->stopper_) uv_async_send(worker->stopper_);
+  }
+
+  void join() {
+    for (auto &worker : workers_)
+      if (worker->thread_.joinable()) worker->thread_.join();
+  }
+
+  std::size_t size() const _NOEXCEPT { return workers_.size(); }
+
+  Worker &worker(std::size_t index) { return *workers_.at(index); }
+
+ private:
+  Options options_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  WorkingCompletionBlock starting_;
+  WorkingCompletionBlock stopping_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::size_t ready_count_ = 0;
+  std::exception_ptr error_;
+
+  static std::vector<int> _availableCpus() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+#endif
+    if (cpus.empty()) {
+      auto count = std::thread::hardware_concurrency();
+      for (unsigned cpu = 0; cpu < (count ? count : 1); ++cpu)
+        cpus.push_back(static_cast<int>(cpu));
+    }
+    return cpus;
+  }
+
+  static void _pin(int cpu) _NOEXCEPT {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err)
+      uvcc::Logger::shared().error(uvcc::Exception(-err), UV_UNKNOWN_HANDLE,
+                                   "cpu affinity");
+#endif
+  }
+
+  void _closeStopper(Worker &worker) _NOEXCEPT {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!worker.stopper_) return;
+    uv_close(reinterpret_cast<uv_handle_t *>(worker.stopper_),
+             [](uv_handle_t *handle) {
+               delete reinterpret_cast<uv_async_t *>(handle);
+             });
+    worker.stopper_ = nullptr;
+  }
+
+  void _run(Worker &worker) {
+    uv_async_t *stopper = nullptr;
+    std::exception_ptr error;
+    try {
+      if (options_.pinned) _pin(worker.cpu_);
+      worker.loop_ = uvcc::make_unique<uvcc::EventLoop>();
+      worker.buffers_ = uvcc::make_unique<uvcc::BufferPool>(
+          options_.buffer_size, options_.max_cached_buffers);
+      worker.requests_ =
+          uvcc::make_unique<uvcc::RequestPool>(options_.max_cached_requests);
+      stopper = new uv_async_t();
+      stopper->data = &worker;
+      uv_async_init(worker.loop_->raw_.get(), stopper, [](uv_async_t *handle) {
+        auto &worker = *static_cast<Worker *>(handle->data);
+        if (worker.runtime_->stopping_) worker.runtime_->stopping_(worker);
+        worker.runtime_->_closeStopper(worker);
+        uv_stop(handle->loop);
+      });
+      if (starting_) starting_(worker);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      worker.stopper_ = stopper;
+      if (error && !error_) error_ = error;
+      ++ready_count_;
+    }
+    ready_.notify_all();
+    if (!error) worker.loop_->run(uvcc::RunOption::kDefault);
+    _closeStopper(worker);
+    if (worker.loop_) worker.loop_->run(uvcc::RunOption::kNoWait);
+    worker.requests_.reset();
+    worker.buffers_.reset();
+    worker.loop_.reset();
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // RUNTIME_H
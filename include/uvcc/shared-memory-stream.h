@@ -0,0 +1,465 @@
+/// MIT License
+///
+/// uvcc/shared-memory-stream.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef SHAREDMEMORYSTREAM_H
+#define SHAREDMEMORYSTREAM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "stream.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Same-host byte stream over a pair of single-producer, single-consumer
+/// rings in shared memory. A connected named pipe carries the setup line
+/// naming the region and, afterwards, one-byte doorbells: a side only rings
+/// when its peer has gone to sleep on an empty ring or is waiting for space,
+/// so a busy stream moves data with plain copies and no syscalls. One side
+/// calls `offer()`, the other `join()`; the pipe belongs to the stream from
+/// then on and must outlive it. No libuv request backs its writes or its
+/// shutdown, so their blocks get a stand-in whose `handle` is the pipe.
+class SharedMemoryStream {
+ public:
+  using AllocatingCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_alloc_cb>>;
+  using ReadingCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_read_cb>>;
+  using WritingCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_write_cb>>;
+  using ShutdownCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_shutdown_cb>>;
+  using ConnectingCompletionBlock = std::function<void(int)>;
+
+  explicit SharedMemoryStream(uvcc::Stream &control)
+      : control_(control), idle_(new uv_idle_t()) {
+    if (!control.loop_) uvcc::expr_throws(UV_EINVAL);
+    uv_idle_init(control._someStream()->loop, idle_);
+    idle_->data = this;
+  }
+  SharedMemoryStream(const SharedMemoryStream &) = delete;
+  SharedMemoryStream &operator=(const SharedMemoryStream &) = delete;
+  ~SharedMemoryStream() {
+    if (state_ != State::kIdle) control_.stopReading();
+    uv_close(reinterpret_cast<uv_handle_t *>(idle_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_idle_t *>(handle);
+    });
+    if (!name_.empty()) ::shm_unlink(name_.c_str());
+    if (region_) ::munmap(region_, region_size_);
+  }
+
+  /// Creates the rings, `capacity` bytes each way, and sends their name.
+  void offer(std::size_t capacity, ConnectingCompletionBlock &&block) {
+    if (state_ != State::kIdle) uvcc::expr_throws(UV_EALREADY);
+    static std::atomic<unsigned> sequence(0);
+    char name[64];
+    std::snprintf(name, sizeof(name), "/uvcc-%d-%u-%llx",
+                  static_cast<int>(::getpid()), sequence++,
+                  static_cast<unsigned long long>(uv_hrtime()));
+    capacity_ = _roundUp(capacity);
+    auto fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) uvcc::expr_throws(-errno);
+    name_ = name;
+    if (::ftruncate(fd, static_cast<off_t>(_regionSize())) < 0) {
+      auto err = -errno;
+      ::close(fd);
+      uvcc::expr_throws(err);
+    }
+    auto err = _map(fd);
+    ::close(fd);
+    uvcc::expr_throws(err);
+    for (auto ring : {_ring(0), _ring(1)}) new (ring) Ring();
+    tx_ = _ring(0);
+    rx_ = _ring(1);
+    setup_ = name_ + " " + std::to_string(capacity_) + "\n";
+    connecting_block_ = std::move(block);
+    state_ = State::kOffering;
+    control_.write(uv_buf_init(&setup_[0],
+                               static_cast<unsigned int>(setup_.size())));
+    _listen();
+  }
+
+  /// Waits for the peer's `offer()` and maps the rings it names.
+  void join(ConnectingCompletionBlock &&block) {
+    if (state_ != State::kIdle) uvcc::expr_throws(UV_EALREADY);
+    connecting_block_ = std::move(block);
+    state_ = State::kJoining;
+    _listen();
+  }
+
+  void startReading(AllocatingCompletionBlock &&allocating,
+                    ReadingCompletionBlock &&reading) {
+    if (state_ != State::kConnected) uvcc::expr_throws(UV_ENOTCONN);
+    allocating_block_ = std::move(allocating);
+    reading_block_ = std::move(reading);
+    reading_ = true;
+    _schedule();
+  }
+
+  void stopReading() _NOEXCEPT { reading_ = false; }
+
+  /// Copies `bufs` into the ring; they must stay valid until `block` runs.
+  void write(const uv_buf_t *bufs, unsigned int count,
+             WritingCompletionBlock &&block = {}) {
+    if (state_ != State::kConnected || shutting_) uvcc::expr_throws(UV_EPIPE);
+    pending_.emplace_back();
+    auto &write = pending_.back();
+    write.bufs.assign(bufs, bufs + count);
+    write.block = std::move(block);
+    _flush();
+    _schedule();
+  }
+
+  void write(const uv_buf_t &buf, WritingCompletionBlock &&block = {}) {
+    write(&buf, 1, std::move(block));
+  }
+
+  /// Signals EOF to the peer once every queued write has been copied.
+  void shutdown(ShutdownCompletionBlock &&block = {}) {
+    if (state_ != State::kConnected || shutting_) uvcc::expr_throws(UV_EPIPE);
+    shutting_ = true;
+    shutdown_block_ = std::move(block);
+    _flush();
+    _schedule();
+  }
+
+  bool isConnected() const _NOEXCEPT { return state_ == State::kConnected; }
+
+  std::size_t capacity() const _NOEXCEPT { return capacity_; }
+
+  /// Doorbells rung to wake the peer.
+  std::uint64_t doorbellCount() const _NOEXCEPT { return doorbells_; }
+
+ private:
+  enum class State : int {
+    kIdle = 0,
+    kOffering,
+    kJoining,
+    kConnected,
+    kClosed,
+  };
+
+  struct Ring {
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    alignas(64) std::atomic<std::uint32_t> sleeping{1};
+    std::atomic<std::uint32_t> starved{0};
+    std::atomic<std::uint32_t> closed{0};
+  };
+
+  struct Write {
+    std::vector<uv_buf_t> bufs;
+    std::size_t index = 0;
+    std::size_t offset = 0;
+    WritingCompletionBlock block;
+  };
+
+  uvcc::Stream &control_;
+  uv_idle_t *idle_;
+  State state_ = State::kIdle;
+  std::string name_;
+  std::string setup_;
+  void *region_ = nullptr;
+  std::size_t region_size_ = 0;
+  std::size_t capacity_ = 0;
+  Ring *tx_ = nullptr;
+  Ring *rx_ = nullptr;
+  char control_buffer_[256];
+  ConnectingCompletionBlock connecting_block_;
+  AllocatingCompletionBlock allocating_block_;
+  ReadingCompletionBlock reading_block_;
+  ShutdownCompletionBlock shutdown_block_;
+  std::deque<Write> pending_;
+  std::vector<WritingCompletionBlock> completed_;
+  std::uint64_t doorbells_ = 0;
+  bool reading_ = false;
+  bool shutting_ = false;
+  bool peer_gone_ = false;
+  bool busy_ = false;
+  bool retry_ = false;
+
+  static std::size_t _roundUp(std::size_t capacity) _NOEXCEPT {
+    std::size_t size = 4096;
+    while (size < capacity) size <<= 1;
+    return size;
+  }
+
+  std::size_t _regionSize() const _NOEXCEPT {
+    return 2 * (sizeof(Ring) + capacity_);
+  }
+
+  Ring *_ring(int index) const _NOEXCEPT {
+    return reinterpret_cast<Ring *>(static_cast<char *>(region_) +
+                                    index * (sizeof(Ring) + capacity_));
+  }
+
+  char *_data(Ring *ring) const _NOEXCEPT {
+    return reinterpret_cast<char *>(ring + 1);
+  }
+
+  int _map(int fd) _NOEXCEPT {
+    region_size_ = _regionSize();
+    auto region = ::mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) return -errno;
+    region_ = region;
+    return 0;
+  }
+
+  void _listen() {
+    control_.startReading(
+        [this](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+          *buf = uv_buf_init(control_buffer_, sizeof(control_buffer_));
+        },
+        [this](uv_stream_t *, ssize_t nread, const uv_buf_t *buf) {
+          if (nread < 0) return _disconnected(static_cast<int>(nread));
+          _control(buf->base, static_cast<std::size_t>(nread));
+        });
+  }
+
+  void _control(const char *data, std::size_t size) {
+    if (!size) return;
+    if (state_ == State::kOffering) {
+      ::shm_unlink(name_.c_str());
+      name_.clear();
+      _connected(0);
+      return _schedule();
+    }
+    if (state_ == State::kJoining) {
+      auto end = std::find(data, data + size, '\n');
+      setup_.append(data, end);
+      if (end == data + size) {
+        if (setup_.size() > sizeof(control_buffer_)) _connected(UV_EPROTO);
+        return;
+      }
+      auto err = _join();
+      if (!err) {
+        static char ack = 0;
+        control_.write(uv_buf_init(&ack, 1));
+      }
+      _connected(err);
+      return _schedule();
+    }
+    if (state_ == State::kConnected) _service();
+  }
+
+  int _join() _NOEXCEPT {
+    auto space = setup_.find(' ');
+    if (space == std::string::npos) return UV_EPROTO;
+    auto name = setup_.substr(0, space);
+    capacity_ = std::strtoull(setup_.c_str() + space + 1, nullptr, 10);
+    if (capacity_ != _roundUp(capacity_)) return UV_EPROTO;
+    auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return -errno;
+    struct stat st;
+    auto err = ::fstat(fd, &st) < 0 ? -errno : 0;
+    if (!err && static_cast<std::size_t>(st.st_size) != _regionSize())
+      err = UV_EPROTO;
+    if (!err) err = _map(fd);
+    ::close(fd);
+    if (err) return err;
+    tx_ = _ring(1);
+    rx_ = _ring(0);
+    return 0;
+  }
+
+  void _connected(int status) {
+    state_ = status ? State::kClosed : State::kConnected;
+    if (status) control_.stopReading();
+    auto block = std::move(connecting_block_);
+    if (block) block(status);
+  }
+
+  void _disconnected(int status) {
+    if (state_ != State::kConnected) {
+      if (state_ == State::kOffering || state_ == State::kJoining)
+        _connected(status == UV_EOF ? UV_ECONNRESET : status);
+      return;
+    }
+    control_.stopReading();
+    peer_gone_ = true;
+    _schedule();
+  }
+
+  void _schedule() _NOEXCEPT {
+    uv_idle_start(idle_, [](uv_idle_t *handle) {
+      static_cast<SharedMemoryStream *>(handle->data)->_service();
+    });
+  }
+
+  /// Copies up to `size` bytes into the transmit ring.
+  std::size_t _push(const char *data, std::size_t size) _NOEXCEPT {
+    auto head = tx_->head.load(std::memory_order_relaxed);
+    auto tail = tx_->tail.load(std::memory_order_acquire);
+    auto n = std::min<std::size_t>(size, capacity_ - (head - tail));
+    auto offset = static_cast<std::size_t>(head & (capacity_ - 1));
+    auto first = std::min(n, capacity_ - offset);
+    std::memcpy(_data(tx_) + offset, data, first);
+    std::memcpy(_data(tx_), data + first, n - first);
+    tx_->head.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  void _flush() {
+    bool pushed = false;
+    while (!pending_.empty()) {
+      auto &write = pending_.front();
+      for (; write.index < write.bufs.size(); ++write.index) {
+        auto &buf = write.bufs[write.index];
+        auto n = _push(buf.base + write.offset, buf.len - write.offset);
+        pushed = pushed || n;
+        write.offset += n;
+        if (write.offset < buf.len) break;
+        write.offset = 0;
+      }
+      if (write.index < write.bufs.size()) break;
+      completed_.push_back(std::move(write.block));
+      pending_.pop_front();
+    }
+    if (pending_.empty() && shutting_ && !tx_->closed.load()) {
+      tx_->closed.store(1);
+      _doorbell();
+    } else if (pushed) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (tx_->sleeping.exchange(0)) _doorbell();
+    }
+    if (!pending_.empty()) {
+      tx_->starved.store(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (tx_->head.load(std::memory_order_relaxed) - tx_->tail.load() <
+          capacity_) {
+        tx_->starved.store(0);
+        retry_ = true;
+        _schedule();
+      }
+    }
+  }
+
+  /// Delivers what is in the receive ring now; true if more arrived since.
+  bool _drain() {
+    auto tail = rx_->tail.load(std::memory_order_relaxed);
+    auto head = rx_->head.load(std::memory_order_acquire);
+    auto stream = control_._someStream();
+    auto handle = reinterpret_cast<uv_handle_t *>(stream);
+    while (reading_ && tail != head) {
+      auto buf = uv_buf_init(nullptr, 0);
+      allocating_block_(handle, 64 * 1024, &buf);
+      if (!buf.base || !buf.len) {
+        reading_block_(stream, UV_ENOBUFS, &buf);
+        return false;
+      }
+      auto n = std::min<std::size_t>(buf.len, head - tail);
+      auto offset = static_cast<std::size_t>(tail & (capacity_ - 1));
+      auto first = std::min(n, capacity_ - offset);
+      std::memcpy(buf.base, _data(rx_) + offset, first);
+      std::memcpy(buf.base + first, _data(rx_), n - first);
+      tail += n;
+      rx_->tail.store(tail, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (rx_->starved.exchange(0)) _doorbell();
+      reading_block_(stream, static_cast<ssize_t>(n), &buf);
+    }
+    if (!reading_) return false;
+    rx_->sleeping.store(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (rx_->head.load(std::memory_order_acquire) == tail) {
+      if (!rx_->closed.load() && !peer_gone_) return false;
+      reading_ = false;
+      auto buf = uv_buf_init(nullptr, 0);
+      reading_block_(stream, UV_EOF, &buf);
+      return false;
+    }
+    rx_->sleeping.store(0);
+    return true;
+  }
+
+  void _service() {
+    if (busy_ || state_ != State::kConnected) {
+      uv_idle_stop(idle_);
+      return;
+    }
+    busy_ = true;
+    retry_ = false;
+    if (peer_gone_) {
+      for (auto &write : pending_) completed_.push_back(std::move(write.block));
+      auto failed = pending_.size();
+      pending_.clear();
+      if (shutting_) tx_->closed.store(1);
+      _complete(failed);
+    } else {
+      _flush();
+    }
+    auto more = _drain();
+    _complete(0);
+    busy_ = false;
+    if (!more && !retry_ && completed_.empty()) uv_idle_stop(idle_);
+  }
+
+  /// Runs finished write blocks; the last `failed` of them get `UV_EPIPE`.
+  void _complete(std::size_t failed) {
+    auto blocks = std::move(completed_);
+    completed_.clear();
+    auto request = uvcc::WriteCoalescer::unsubmitted(control_._someStream());
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+      if (blocks[i])
+        blocks[i](&request, i + failed < blocks.size() ? 0 : UV_EPIPE);
+    if (shutdown_block_ && pending_.empty() && tx_->closed.load()) {
+      auto block = std::move(shutdown_block_);
+      shutdown_block_ = nullptr;
+      auto shutdown = uv_shutdown_t();
+      shutdown.type = UV_SHUTDOWN;
+      shutdown.handle = control_._someStream();
+      block(&shutdown, peer_gone_ ? UV_EPIPE : 0);
+    }
+  }
+
+  void _doorbell() {
+    static char bell = 1;
+    auto buf = uv_buf_init(&bell, 1);
+    ++doorbells_;
+    auto err = uv_try_write(control_._someStream(), &buf, 1);
+    if (err == UV_EAGAIN || err == UV_ENOSYS) control_.write(buf);
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // SHAREDMEMORYSTREAM_H
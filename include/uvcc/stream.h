@@ -29,11 +29,24 @@
 
 #include <uv.h>
 
+#include <deque>
+
 #include "file-descriptor.h"
+#include "token-bucket.h"
+#include "traffic-capture.h"
 
 namespace uvcc {
 
+namespace network {
+class Listener;
+}  // namespace network
+
 class Stream : protected FileDescriptor {
+  friend class Broadcaster;
+  friend class Relay;
+  friend class SharedMemoryStream;
+  friend class network::Listener;
+
  protected:
   using ReadingRawCompletionBlock = uvcc::RawCompletionBlock<uv_read_cb>;
   using ReadingCompletionBlock = std::function<ReadingRawCompletionBlock>;
@@ -75,9 +88,10 @@ class Stream : protected FileDescriptor {
         raw_->stream = decltype(raw_->stream)();
         break;
       default:
-        raw_ = uvcc::make_unique<Self>();
+        raw_ = _makeRaw();
         break;
     }
+    _someRaw()->type = _rawType(type);
   }
   Stream(const Self &self, ClosingCompletionBlock &&block)
       : FileDescriptor(self, std::move(block)) {}
@@ -85,7 +99,113 @@ class Stream : protected FileDescriptor {
       : FileDescriptor(std::move(self), std::move(block)) {}
   Stream(Stream &&) _NOEXCEPT = default;
   Stream &operator=(Stream &&) _NOEXCEPT = default;
-  virtual ~Stream() = default;
+  virtual ~Stream() {
+    if (batch_) loop_->coalescer().remove(*batch_);
+    if (callbacks_ && (callbacks_->read_paused || !callbacks_->held.empty())) {
+      callbacks_->loop->throttle().cancel(callbacks_.get());
+      auto held = std::move(callbacks_->held);
+      auto request = uvcc::WriteCoalescer::unsubmitted(_someStream());
+      for (auto &write : held)
+        if (write.block) write.block(&request, UV_ECANCELED);
+    }
+    if (callbacks_ && callbacks_->capture)
+      callbacks_->capture->record(TrafficCapture::Kind::kClose,
+                                  callbacks_->capture_id);
+  }
+
+  /// Initialises the handle on `loop`; TCP and named pipes only.
+  void open(uvcc::EventLoop &loop) {
+    switch (_someRaw()->type) {
+      case UV_TCP:
+        uvcc::expr_throws(uv_tcp_init(loop.raw_.get(), &raw_->tcp), true);
+        break;
+      case UV_NAMED_PIPE:
+        uvcc::expr_throws(uv_pipe_init(loop.raw_.get(), &raw_->pipe, 0), true);
+        break;
+      default:
+        uvcc::expr_throws(UV_EINVAL);
+    }
+    _someRaw()->data = callbacks_.get();
+    loop_ = &loop;
+    callbacks_->loop = &loop;
+  }
+
+  void listen(int backlog, RecevingCompletionBlock &&block) {
+    callbacks_->receiving = std::move(block);
+    uvcc::expr_throws(
+        uv_listen(_someStream(), backlog,
+                  [](uv_stream_t *stream, int status) {
+                    static_cast<Callbacks *>(stream->data)
+                        ->receiving(stream, status);
+                  }),
+        true);
+  }
+
+  /// Connects a TCP stream opened with `open()` to `address`.
+  void connect(const sockaddr *address, ConnectingCompletionBlock &&block = {}) {
+    auto request = new ConnectRequest();
+    request->block = std::move(block);
+    request->tracer = loop_ ? loop_->tracer_ : nullptr;
+    auto err = uv_tcp_connect(&request->request, &raw_->tcp, address,
+                              [](uv_connect_t *request, int status) {
+                                std::unique_ptr<ConnectRequest> context(
+                                    reinterpret_cast<ConnectRequest *>(request));
+                                if (context->tracer)
+                                  context->tracer->requestCompleted(request,
+                                                                    UV_CONNECT);
+                                if (context->block) context->block(request, status);
+                              });
+    if (err) delete request;
+    uvcc::expr_throws(err, true);
+    if (request->tracer)
+      request->tracer->requestSubmitted(&request->request, UV_CONNECT);
+  }
+
+  /// Accepts a pending connection into `client`, opened on the same loop.
+  void accept(Stream &client) {
+    uvcc::expr_throws(uv_accept(_someStream(), client._someStream()), true);
+  }
+
+  /// Reads until `stopReading()`; `reading` is also told about EOF and
+  /// errors through a negative `nread`, as with `uv_read_cb`.
+  void startReading(AllocatingCompletionBlock &&allocating,
+                    ReadingCompletionBlock &&reading) {
+    callbacks_->allocating = std::move(allocating);
+    callbacks_->reading = std::move(reading);
+    callbacks_->reading_enabled = true;
+    if (_delay(callbacks_->read_limit, callbacks_->shared_read_limit)) {
+      callbacks_->read_paused = true;
+      return _throttle(_someStream());
+    }
+    uvcc::expr_throws(uv_read_start(_someStream(), _allocate, _read), true);
+  }
+
+  void stopReading() _NOEXCEPT {
+    callbacks_->reading_enabled = false;
+    callbacks_->read_paused = false;
+    uv_read_stop(_someStream());
+    if (callbacks_->loop && callbacks_->held.empty())
+      callbacks_->loop->throttle().cancel(callbacks_.get());
+  }
+
+  void shutdown(ShutdownCompletionBlock &&block = {}) {
+    auto request = new ShutdownRequest();
+    request->block = std::move(block);
+    request->tracer = loop_ ? loop_->tracer_ : nullptr;
+    auto err = uv_shutdown(&request->request, _someStream(),
+                           [](uv_shutdown_t *request, int status) {
+                             std::unique_ptr<ShutdownRequest> context(
+                                 reinterpret_cast<ShutdownRequest *>(request));
+                             if (context->tracer)
+                               context->tracer->requestCompleted(request,
+                                                                 UV_SHUTDOWN);
+                             if (context->block) context->block(request, status);
+                           });
+    if (err) delete request;
+    uvcc::expr_throws(err, true);
+    if (request->tracer)
+      request->tracer->requestSubmitted(&request->request, UV_SHUTDOWN);
+  }
 
   bool isReadable() const _NOEXCEPT { return uv_is_readable(_someStream()); }
 
@@ -100,7 +220,128 @@ class Stream : protected FileDescriptor {
     return uv_stream_get_write_queue_size(_someStream());
   }
 
+  /// Writes `bufs`, which must stay valid until `block` is called. On a
+  /// corked stream the write is merged with the others issued during this
+  /// loop iteration and `block` runs when the merged write completes. A
+  /// write that never reaches libuv, because its batch failed to submit or
+  /// it was still held when the stream went away, gets
+  /// `WriteCoalescer::unsubmitted()` instead of a live request.
+  void write(const uv_buf_t *bufs, unsigned int count,
+             WritingCompletionBlock &&block = {}) {
+    if (callbacks_->capture)
+      callbacks_->capture->record(TrafficCapture::Kind::kWrite,
+                                  callbacks_->capture_id, bufs, count);
+    if (callbacks_->write_limit || callbacks_->shared_write_limit) {
+      if (!callbacks_->held.empty() ||
+          _delay(callbacks_->write_limit, callbacks_->shared_write_limit)) {
+        callbacks_->held.push_back(
+            HeldWrite{std::vector<uv_buf_t>(bufs, bufs + count),
+                      std::move(block)});
+        return _throttle(_someStream());
+      }
+      _consume(callbacks_->write_limit, callbacks_->shared_write_limit,
+               _length(bufs, count));
+    }
+    uvcc::expr_throws(
+        _submit(_someStream(), batch_.get(), bufs, count, std::move(block)));
+  }
+
+  void write(const uv_buf_t &buf, WritingCompletionBlock &&block = {}) {
+    write(&buf, 1, std::move(block));
+  }
+
+  /// Opts the stream in or out of per-iteration write coalescing; corking
+  /// requires a stream opened on an `EventLoop`.
+  void setCorked(bool corked) {
+    if (corked == isCorked()) return;
+    if (!loop_) uvcc::expr_throws(UV_EINVAL);
+    if (corked) {
+      batch_ = uvcc::make_unique<uvcc::WriteCoalescer::Batch>(_someStream());
+    } else {
+      loop_->coalescer().remove(*batch_);
+      batch_.reset();
+    }
+    callbacks_->batch = batch_.get();
+  }
+
+  bool isCorked() const _NOEXCEPT { return batch_ != nullptr; }
+
+  /// Limits inbound bytes to `rate` per second with bursts of `burst`;
+  /// reading pauses while the budget is spent. A zero rate removes it; a
+  /// zero burst with a non-zero rate throws `UV_EINVAL`, as it never refills.
+  void setReadLimit(std::uint64_t rate, std::uint64_t burst) {
+    _setLimit(callbacks_->read_limit, rate, burst);
+  }
+
+  /// Limits outbound bytes; writes beyond the budget are queued in order
+  /// and issued as it refills.
+  void setWriteLimit(std::uint64_t rate, std::uint64_t burst) {
+    _setLimit(callbacks_->write_limit, rate, burst);
+  }
+
+  /// Charges inbound bytes to `bucket` too, which other streams may share;
+  /// a bucket with a zero rate or burst throws `UV_EINVAL`, as it would
+  /// never refill.
+  void setSharedReadLimit(std::shared_ptr<uvcc::TokenBucket> bucket) {
+    _setLimit(callbacks_->shared_read_limit, std::move(bucket));
+  }
+
+  void setSharedWriteLimit(std::shared_ptr<uvcc::TokenBucket> bucket) {
+    _setLimit(callbacks_->shared_write_limit, std::move(bucket));
+  }
+
+  /// Whether reading is paused or writes are held by a rate limit.
+  bool isThrottled() const _NOEXCEPT {
+    return callbacks_->read_paused || !callbacks_->held.empty();
+  }
+
+  /// Records this stream's reads and writes into `capture`, which must
+  /// outlive it; null stops recording.
+  void setCapture(uvcc::TrafficCapture *capture) _NOEXCEPT {
+    callbacks_->capture = capture;
+    callbacks_->capture_id = capture ? capture->open() : 0;
+  }
+
  protected:
+  struct HeldWrite {
+    std::vector<uv_buf_t> bufs;
+    WritingCompletionBlock block;
+  };
+
+  struct Callbacks
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kCallbacks> {
+    AllocatingCompletionBlock allocating;
+    ReadingCompletionBlock reading;
+    RecevingCompletionBlock receiving;
+    uvcc::TrafficCapture *capture = nullptr;
+    std::uint32_t capture_id = 0;
+    std::shared_ptr<uvcc::TokenBucket> read_limit, shared_read_limit;
+    std::shared_ptr<uvcc::TokenBucket> write_limit, shared_write_limit;
+    uvcc::EventLoop *loop = nullptr;
+    uvcc::WriteCoalescer::Batch *batch = nullptr;
+    std::deque<HeldWrite> held;
+    bool reading_enabled = false;
+    bool read_paused = false;
+  };
+
+  struct ShutdownRequest
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kRequests> {
+    uv_shutdown_t request;
+    ShutdownCompletionBlock block;
+    uvcc::Tracer *tracer;
+  };
+
+  struct ConnectRequest
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kRequests> {
+    uv_connect_t request;
+    ConnectingCompletionBlock block;
+    uvcc::Tracer *tracer;
+  };
+
+  uvcc::EventLoop *loop_ = nullptr;
+  std::unique_ptr<uvcc::WriteCoalescer::Batch> batch_;
+  std::unique_ptr<Callbacks> callbacks_ = uvcc::make_unique<Callbacks>();
+
   inline virtual bool _validateType() const _NOEXCEPT {
     auto t = _someStream()->type;
     return t == UV_STREAM || t == UV_TCP || t == UV_TTY || t == UV_NAMED_PIPE ||
@@ -114,6 +355,152 @@ class Stream : protected FileDescriptor {
   }
 
  private:
+  static void _allocate(uv_handle_t *handle, std::size_t size, uv_buf_t *buf) {
+    static_cast<Callbacks *>(handle->data)->allocating(handle, size, buf);
+  }
+
+  static void _read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
+    auto callbacks = static_cast<Callbacks *>(stream->data);
+    if (nread > 0) {
+      if (callbacks->capture)
+        callbacks->capture->record(TrafficCapture::Kind::kRead,
+                                   callbacks->capture_id, buf->base,
+                                   static_cast<std::size_t>(nread));
+      if (callbacks->read_limit || callbacks->shared_read_limit) {
+        _consume(callbacks->read_limit, callbacks->shared_read_limit,
+                 static_cast<std::uint64_t>(nread), stream->loop);
+        if (_delay(callbacks->read_limit, callbacks->shared_read_limit,
+                   stream->loop)) {
+          uv_read_stop(stream);
+          callbacks->read_paused = true;
+          _throttle(stream);
+        }
+      }
+    }
+    callbacks->reading(stream, nread, buf);
+  }
+
+  /// Resumes whatever the buckets now allow and waits again for the rest.
+  /// Once a held write fails to submit, it and every write behind it
+  /// complete with the error, last, as their blocks may close the stream.
+  static void _resume(uv_stream_t *stream) {
+    auto callbacks = static_cast<Callbacks *>(stream->data);
+    std::deque<HeldWrite> failed;
+    auto failure = 0;
+    while (!callbacks->held.empty() &&
+           !_delay(callbacks->write_limit, callbacks->shared_write_limit,
+                   stream->loop)) {
+      auto &write = callbacks->held.front();
+      _consume(callbacks->write_limit, callbacks->shared_write_limit,
+               _length(write.bufs.data(), write.bufs.size()), stream->loop);
+      failure = _submit(stream, callbacks->batch, write.bufs.data(),
+                        static_cast<unsigned int>(write.bufs.size()),
+                        std::move(write.block));
+      if (failure) {
+        failed.swap(callbacks->held);
+        break;
+      }
+      callbacks->held.pop_front();
+    }
+    if (callbacks->read_paused &&
+        !_delay(callbacks->read_limit, callbacks->shared_read_limit,
+                stream->loop)) {
+      callbacks->read_paused = false;
+      auto err = uv_read_start(stream, _allocate, _read);
+      if (err) {
+        auto buf = uv_buf_init(nullptr, 0);
+        callbacks->reading(stream, err, &buf);
+      }
+    }
+    if (callbacks->read_paused || !callbacks->held.empty()) _throttle(stream);
+    if (failed.empty()) return;
+    auto request = uvcc::WriteCoalescer::unsubmitted(stream);
+    for (auto &write : failed)
+      if (write.block) write.block(&request, failure);
+  }
+
+  static void _throttle(uv_stream_t *stream) {
+    auto callbacks = static_cast<Callbacks *>(stream->data);
+    auto delay = UINT64_MAX;
+    if (callbacks->read_paused)
+      delay = _delay(callbacks->read_limit, callbacks->shared_read_limit,
+                     stream->loop);
+    if (!callbacks->held.empty())
+      delay = std::min(delay, _delay(callbacks->write_limit,
+                                     callbacks->shared_write_limit,
+                                     stream->loop));
+    callbacks->loop->throttle().defer(callbacks, delay,
+                                      [stream] { _resume(stream); });
+  }
+
+  static std::uint64_t _delay(const std::shared_ptr<TokenBucket> &own,
+                              const std::shared_ptr<TokenBucket> &shared,
+                              uv_loop_t *loop) _NOEXCEPT {
+    auto now = uv_now(loop);
+    std::uint64_t delay = 0;
+    if (own) delay = own->delay(now);
+    if (shared) delay = std::max(delay, shared->delay(now));
+    return delay;
+  }
+
+  std::uint64_t _delay(const std::shared_ptr<TokenBucket> &own,
+                       const std::shared_ptr<TokenBucket> &shared) const
+      _NOEXCEPT {
+    return _delay(own, shared, _someStream()->loop);
+  }
+
+  static void _consume(const std::shared_ptr<TokenBucket> &own,
+                       const std::shared_ptr<TokenBucket> &shared,
+                       std::uint64_t bytes, uv_loop_t *loop) _NOEXCEPT {
+    auto now = uv_now(loop);
+    if (own) own->consume(bytes, now);
+    if (shared) shared->consume(bytes, now);
+  }
+
+  void _consume(const std::shared_ptr<TokenBucket> &own,
+                const std::shared_ptr<TokenBucket> &shared,
+                std::uint64_t bytes) const _NOEXCEPT {
+    _consume(own, shared, bytes, _someStream()->loop);
+  }
+
+  static std::uint64_t _length(const uv_buf_t *bufs,
+                               std::size_t count) _NOEXCEPT {
+    std::uint64_t length = 0;
+    for (std::size_t i = 0; i < count; ++i) length += bufs[i].len;
+    return length;
+  }
+
+  void _setLimit(std::shared_ptr<TokenBucket> &slot, std::uint64_t rate,
+                 std::uint64_t burst) {
+    _setLimit(slot, rate ? std::make_shared<TokenBucket>(rate, burst)
+                         : std::shared_ptr<TokenBucket>());
+  }
+
+  void _setLimit(std::shared_ptr<TokenBucket> &slot,
+                 std::shared_ptr<TokenBucket> &&bucket) {
+    if (!loop_ || (bucket && (!bucket->rate() || !bucket->burst())))
+      uvcc::expr_throws(UV_EINVAL);
+    slot = std::move(bucket);
+    if (isThrottled()) _throttle(_someStream());
+  }
+
+  static int _submit(uv_stream_t *stream, uvcc::WriteCoalescer::Batch *batch,
+                     const uv_buf_t *bufs, unsigned int count,
+                     WritingCompletionBlock &&block) {
+    auto callbacks = static_cast<Callbacks *>(stream->data);
+    auto loop = callbacks ? callbacks->loop : nullptr;
+    if (batch) {
+      loop->coalescer().enqueue(*batch, bufs, count, std::move(block));
+      return 0;
+    }
+    std::vector<WritingCompletionBlock> blocks(1, std::move(block));
+    auto err = uvcc::WriteCoalescer::submit(stream, bufs, count, blocks,
+                                            loop ? loop->tracer_ : nullptr);
+    // Hands the block back so that the caller can complete it.
+    if (err) block = std::move(blocks.front());
+    return err;
+  }
+
   inline TransmitType _type(const uv_handle_type &raw_type) const _NOEXCEPT {
     return static_cast<TransmitType>(raw_type);
   }
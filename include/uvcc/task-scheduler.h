@@ -0,0 +1,176 @@
+/// MIT License
+///
+/// uvcc/task-scheduler.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Cooperative scheduler for deferred work on one loop. Tasks run from the
+/// check phase in slices until the per-iteration budget is spent, then the
+/// loop goes back to polling; an idle handle keeps that poll from blocking
+/// while work is pending. Higher classes run first, earliest deadline first
+/// within a class, and a task past its deadline jumps ahead of every class.
+class TaskScheduler {
+ public:
+  enum class Priority : int {
+    kHigh = 0,
+    kNormal,
+    kLow,
+  };
+
+  /// Returns true to be resumed in a later slice.
+  using TaskBlock = std::function<bool()>;
+
+  explicit TaskScheduler(uv_loop_t *loop)
+      : loop_(loop), idle_(new uv_idle_t()), check_(new uv_check_t()) {
+    uv_idle_init(loop, idle_);
+    uv_check_init(loop, check_);
+    idle_->data = check_->data = this;
+  }
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+  ~TaskScheduler() {
+    uv_close(reinterpret_cast<uv_handle_t *>(idle_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_idle_t *>(handle);
+    });
+    uv_close(reinterpret_cast<uv_handle_t *>(check_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_check_t *>(handle);
+    });
+  }
+
+  /// `deadline` is in milliseconds from now; zero means none.
+  void post(TaskBlock &&block, Priority priority = Priority::kNormal,
+            std::uint64_t deadline = 0) {
+    auto due = deadline ? uv_now(loop_) + deadline
+                        : std::numeric_limits<std::uint64_t>::max();
+    _push(queues_[static_cast<int>(priority)],
+          Task{due, sequence_++, std::move(block)});
+    if (pending_++ == 0) {
+      uv_idle_start(idle_, [](uv_idle_t *) {});
+      uv_check_start(check_, [](uv_check_t *handle) {
+        static_cast<TaskScheduler *>(handle->data)->runSlice();
+      });
+    }
+  }
+
+  /// Runs tasks until the budget is spent; at least one runs per call.
+  void runSlice() {
+    auto start = uv_hrtime();
+    auto limit = budget_ * 1000;
+    ++slices_;
+    while (pending_) {
+      auto &queue = _next();
+      std::pop_heap(queue.begin(), queue.end(), Later());
+      auto task = std::move(queue.back());
+      queue.pop_back();
+      --pending_;
+      ++executed_;
+      if (task.block()) {
+        task.sequence = sequence_++;
+        _push(queue, std::move(task));
+        ++pending_;
+      }
+      if (uv_hrtime() - start >= limit) {
+        if (pending_) ++yields_;
+        break;
+      }
+    }
+    if (!pending_) {
+      uv_idle_stop(idle_);
+      uv_check_stop(check_);
+    }
+  }
+
+  /// Per-iteration budget in microseconds.
+  std::uint64_t budget() const _NOEXCEPT { return budget_; }
+
+  void setBudget(std::uint64_t budget) _NOEXCEPT { budget_ = budget; }
+
+  std::size_t pendingCount() const _NOEXCEPT { return pending_; }
+
+  std::uint64_t executedCount() const _NOEXCEPT { return executed_; }
+
+  std::uint64_t sliceCount() const _NOEXCEPT { return slices_; }
+
+  /// Slices that stopped on the budget with work left over.
+  std::uint64_t yieldCount() const _NOEXCEPT { return yields_; }
+
+ private:
+  struct Task {
+    std::uint64_t deadline;
+    std::uint64_t sequence;
+    TaskBlock block;
+  };
+
+  struct Later {
+    bool operator()(const Task &lhs, const Task &rhs) const _NOEXCEPT {
+      return lhs.deadline != rhs.deadline ? lhs.deadline > rhs.deadline
+                                          : lhs.sequence > rhs.sequence;
+    }
+  };
+
+  uv_loop_t *loop_;
+  uv_idle_t *idle_;
+  uv_check_t *check_;
+  std::vector<Task> queues_[3];
+  std::size_t pending_ = 0;
+  std::uint64_t sequence_ = 0;
+  std::uint64_t budget_ = 1000;
+  std::uint64_t executed_ = 0;
+  std::uint64_t slices_ = 0;
+  std::uint64_t yields_ = 0;
+
+  static void _push(std::vector<Task> &queue, Task &&task) {
+    queue.push_back(std::move(task));
+    std::push_heap(queue.begin(), queue.end(), Later());
+  }
+
+  std::vector<Task> &_next() _NOEXCEPT {
+    auto now = uv_now(loop_);
+    std::vector<Task> *first = nullptr;
+    for (auto &queue : queues_) {
+      if (queue.empty()) continue;
+      if (queue.front().deadline <= now) return queue;
+      if (!first) first = &queue;
+    }
+    return *first;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // TASKSCHEDULER_H
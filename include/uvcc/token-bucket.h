@@ -0,0 +1,181 @@
+/// MIT License
+///
+/// uvcc/token-bucket.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Byte budget refilled at `rate` bytes per second up to `burst`. Consuming
+/// more than is available leaves the bucket in debt, which later refills
+/// pay off before anything else may pass. Times are loop milliseconds.
+class TokenBucket {
+ public:
+  TokenBucket(std::uint64_t rate, std::uint64_t burst) _NOEXCEPT
+      : rate_(rate),
+        burst_(static_cast<std::int64_t>(burst)),
+        tokens_(static_cast<std::int64_t>(burst)) {}
+
+  void consume(std::uint64_t bytes, std::uint64_t now) _NOEXCEPT {
+    _refill(now);
+    tokens_ -= static_cast<std::int64_t>(bytes);
+  }
+
+  bool isEmpty(std::uint64_t now) _NOEXCEPT {
+    _refill(now);
+    return tokens_ <= 0;
+  }
+
+  /// Milliseconds until the bucket holds tokens again.
+  std::uint64_t delay(std::uint64_t now) _NOEXCEPT {
+    _refill(now);
+    if (tokens_ > 0) return 0;
+    if (!rate_) return UINT64_MAX;
+    return static_cast<std::uint64_t>(1 - tokens_) * 1000 / rate_ + 1;
+  }
+
+  std::uint64_t rate() const _NOEXCEPT { return rate_; }
+
+  std::uint64_t burst() const _NOEXCEPT {
+    return static_cast<std::uint64_t>(burst_);
+  }
+
+ private:
+  std::uint64_t rate_;
+  std::int64_t burst_;
+  std::int64_t tokens_;
+  std::uint64_t updated_ = 0;
+
+  void _refill(std::uint64_t now) _NOEXCEPT {
+    if (now <= updated_) return;
+    if (updated_) {
+      auto refill = (now - updated_) * rate_ / 1000;
+      tokens_ = std::min<std::int64_t>(
+          burst_, tokens_ + static_cast<std::int64_t>(refill));
+    }
+    updated_ = now;
+  }
+};
+
+/// One timer per loop that wakes whatever a bucket has paused. Each waiter
+/// is keyed by an address and holds at most one wake-up.
+class Throttle {
+ public:
+  using ResumingCompletionBlock = std::function<void()>;
+
+  explicit Throttle(uv_loop_t *loop) : timer_(new uv_timer_t()) {
+    uv_timer_init(loop, timer_);
+    timer_->data = this;
+  }
+  Throttle(const Throttle &) = delete;
+  Throttle &operator=(const Throttle &) = delete;
+  ~Throttle() {
+    uv_close(reinterpret_cast<uv_handle_t *>(timer_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_timer_t *>(handle);
+    });
+  }
+
+  /// Calls `block` after `delay` milliseconds, replacing any earlier wait.
+  /// A `delay` of `UINT64_MAX`, as from a bucket that never refills, only
+  /// drops the earlier wait.
+  void defer(const void *key, std::uint64_t delay,
+             ResumingCompletionBlock &&block) {
+    cancel(key);
+    if (delay == UINT64_MAX) return;
+    auto now = uv_now(timer_->loop);
+    auto due = delay < UINT64_MAX - now ? now + delay : UINT64_MAX;
+    auto it = queue_.emplace(due, Waiter{key, std::move(block)});
+    waiters_[key] = it;
+    _arm();
+  }
+
+  void cancel(const void *key) _NOEXCEPT {
+    auto it = waiters_.find(key);
+    if (it == waiters_.end()) return;
+    auto first = it->second == queue_.begin();
+    queue_.erase(it->second);
+    waiters_.erase(it);
+    // An idle timer left armed would keep the loop alive until it fires.
+    if (first) _arm();
+  }
+
+  bool isWaiting(const void *key) const _NOEXCEPT {
+    return waiters_.count(key) != 0;
+  }
+
+  std::size_t waitingCount() const _NOEXCEPT { return waiters_.size(); }
+
+ private:
+  struct Waiter {
+    const void *key;
+    ResumingCompletionBlock block;
+  };
+
+  uv_timer_t *timer_;
+  std::multimap<std::uint64_t, Waiter> queue_;
+  std::unordered_map<const void *,
+                     std::multimap<std::uint64_t, Waiter>::iterator>
+      waiters_;
+
+  void _arm() _NOEXCEPT {
+    if (queue_.empty()) {
+      uv_timer_stop(timer_);
+      return;
+    }
+    auto now = uv_now(timer_->loop);
+    auto due = queue_.begin()->first;
+    uv_timer_start(timer_,
+                   [](uv_timer_t *handle) {
+                     static_cast<Throttle *>(handle->data)->_fire();
+                   },
+                   due > now ? due - now : 0, 0);
+  }
+
+  void _fire() {
+    auto now = uv_now(timer_->loop);
+    while (!queue_.empty() && queue_.begin()->first <= now) {
+      auto block = std::move(queue_.begin()->second.block);
+      waiters_.erase(queue_.begin()->second.key);
+      queue_.erase(queue_.begin());
+      block();
+    }
+    _arm();
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // TOKENBUCKET_H
@@ -0,0 +1,229 @@
+/// MIT License
+///
+/// uvcc/tracer.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <uv.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "ring-buffer.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Opt-in latency tracer. Events are timestamped with `uv_hrtime()` and kept
+/// in a lock-free ring (requests may complete on thread-pool threads), then
+/// written out by `dump()` in the Chrome trace event format understood by
+/// chrome://tracing and Perfetto. Install it with `EventLoop::setTracer()`.
+///
+/// Each loop iteration is recorded as two spans, split where libuv lets a
+/// watcher in without changing how the loop runs: "poll", from the prepare
+/// to the check phase (with "poll.wait" and "poll.io" inside it), and
+/// "post-poll", from there to the next prepare phase. The latter lumps
+/// together check callbacks, closing handles, timers, pending callbacks
+/// and idle handles; telling those apart would take an active idle
+/// handle, which would keep the loop from ever blocking in poll.
+class Tracer {
+  friend class EventLoop;
+
+ public:
+  enum class Phase : char {
+    kComplete = 'X',
+    kInstant = 'i',
+    kAsyncBegin = 'b',
+    kAsyncInstant = 'n',
+    kAsyncEnd = 'e',
+  };
+
+  struct Event {
+    const char *name;
+    const char *category;
+    Phase phase;
+    std::uint32_t thread;
+    std::uint64_t timestamp;
+    std::uint64_t duration;
+    std::uintptr_t id;
+  };
+
+  explicit Tracer(std::size_t capacity = 1 << 16) : events_(capacity) {}
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+  ~Tracer() { _detach(); }
+
+  bool isEnabled() const _NOEXCEPT {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void setEnabled(bool enabled) _NOEXCEPT {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  /// Events for one request, matched by `request`, which only needs to be
+  /// unique while it is in flight. Started is for work that waits in a
+  /// queue first and may be recorded from the thread that runs it.
+  void requestSubmitted(const void *request, uv_req_type type) _NOEXCEPT {
+    _request(request, type, Phase::kAsyncBegin);
+  }
+
+  void requestStarted(const void *request, uv_req_type type) _NOEXCEPT {
+    _request(request, type, Phase::kAsyncInstant);
+  }
+
+  void requestCompleted(const void *request, uv_req_type type) _NOEXCEPT {
+    _request(request, type, Phase::kAsyncEnd);
+  }
+
+  void record(const Event &event) _NOEXCEPT {
+    if (!isEnabled()) return;
+    if (!events_.push(event)) dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::uint64_t droppedCount() const _NOEXCEPT {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /// Drains every buffered event into `path` as a Chrome trace file.
+  void dump(const std::string &path) {
+    auto file = std::fopen(path.c_str(), "w");
+    if (!file) uvcc::expr_throws(-errno);
+    auto pid = static_cast<long>(uv_os_getpid());
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    Event event;
+    bool first = true;
+    while (events_.pop(event)) {
+      std::fprintf(file,
+                   "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+                   "\"pid\":%ld,\"tid\":%u,\"ts\":%.3f",
+                   first ? "" : ",", event.name, event.category,
+                   static_cast<char>(event.phase), pid, event.thread,
+                   event.timestamp / 1e3);
+      if (event.phase == Phase::kComplete)
+        std::fprintf(file, ",\"dur\":%.3f", event.duration / 1e3);
+      if (event.id)
+        std::fprintf(file, ",\"id\":\"0x%llx\"",
+                     static_cast<unsigned long long>(event.id));
+      if (event.phase == Phase::kInstant) std::fputs(",\"s\":\"t\"", file);
+      std::fputc('}', file);
+      first = false;
+    }
+    std::fputs("\n]}\n", file);
+    if (std::fclose(file) != 0) uvcc::expr_throws(-errno);
+  }
+
+ private:
+  RingBuffer<Event> events_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<std::uint64_t> dropped_{0};
+  uv_prepare_t *prepare_ = nullptr;
+  uv_check_t *check_ = nullptr;
+  std::uint64_t poll_entered_ = 0;
+  std::uint64_t poll_left_ = 0;
+  std::uint64_t idle_time_ = 0;
+
+  /// Records the poll and post-poll spans of every iteration of `loop`.
+  void _attach(uv_loop_t *loop) {
+    _detach();
+    auto prepare = new uv_prepare_t();
+    auto check = new uv_check_t();
+    uv_prepare_init(loop, prepare);
+    uv_check_init(loop, check);
+    prepare->data = check->data = this;
+    uv_prepare_start(prepare, [](uv_prepare_t *handle) {
+      static_cast<Tracer *>(handle->data)->_enterPoll(handle->loop);
+    });
+    uv_check_start(check, [](uv_check_t *handle) {
+      static_cast<Tracer *>(handle->data)->_leavePoll(handle->loop);
+    });
+    uv_unref(reinterpret_cast<uv_handle_t *>(prepare));
+    uv_unref(reinterpret_cast<uv_handle_t *>(check));
+    prepare_ = prepare;
+    check_ = check;
+    poll_entered_ = 0;
+    poll_left_ = 0;
+  }
+
+  void _detach() _NOEXCEPT {
+    if (prepare_)
+      uv_close(reinterpret_cast<uv_handle_t *>(prepare_),
+               [](uv_handle_t *handle) {
+                 delete reinterpret_cast<uv_prepare_t *>(handle);
+               });
+    if (check_)
+      uv_close(reinterpret_cast<uv_handle_t *>(check_),
+               [](uv_handle_t *handle) {
+                 delete reinterpret_cast<uv_check_t *>(handle);
+               });
+    prepare_ = nullptr;
+    check_ = nullptr;
+  }
+
+  static std::uint32_t _thread() _NOEXCEPT {
+    static std::atomic<std::uint32_t> next{1};
+    static thread_local std::uint32_t thread =
+        next.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+  }
+
+  void _complete(const char *name, std::uint64_t begin,
+                 std::uint64_t end) _NOEXCEPT {
+    record({name, "loop", Phase::kComplete, _thread(), begin, end - begin, 0});
+  }
+
+  void _request(const void *request, uv_req_type type,
+                const Phase &phase) _NOEXCEPT {
+    auto name = uv_req_type_name(type);
+    record({name ? name : "request", "request", phase, _thread(), uv_hrtime(),
+            0, reinterpret_cast<std::uintptr_t>(request)});
+  }
+
+  void _enterPoll(uv_loop_t *loop) _NOEXCEPT {
+    poll_entered_ = uv_hrtime();
+    idle_time_ = uv_metrics_idle_time(loop);
+    if (poll_left_) _complete("post-poll", poll_left_, poll_entered_);
+  }
+
+  void _leavePoll(uv_loop_t *loop) _NOEXCEPT {
+    poll_left_ = uv_hrtime();
+    if (!poll_entered_) return;
+    auto waited = uv_metrics_idle_time(loop) - idle_time_;
+    _complete("poll", poll_entered_, poll_left_);
+    if (waited) {
+      _complete("poll.wait", poll_entered_, poll_entered_ + waited);
+      _complete("poll.io", poll_entered_ + waited, poll_left_);
+    }
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // TRACER_H
@@ -0,0 +1,194 @@
+/// MIT License
+///
+/// uvcc/traffic-capture.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TRAFFICCAPTURE_H
+#define TRAFFICCAPTURE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <cstring>
+#include <string>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Append-only capture of stream traffic. Records are copied into a
+/// memory-mapped window of the file that is remapped further along as it
+/// fills, so recording costs a copy and no syscall in the common case.
+/// Once `max_size` bytes have been written further records are dropped and
+/// counted. A capture is used from one loop thread.
+class TrafficCapture {
+ public:
+  enum class Kind : std::uint8_t {
+    kOpen = 1,
+    kRead,
+    kWrite,
+    kClose,
+  };
+
+  struct FileHeader {
+    char magic[8];
+    std::uint64_t reserved;
+  };
+
+  /// `timestamp` is in nanoseconds since the capture was opened; `size`
+  /// payload bytes follow, padded to eight.
+  struct RecordHeader {
+    std::uint64_t timestamp;
+    std::uint32_t stream;
+    std::uint32_t size;
+    Kind kind;
+    std::uint8_t reserved[7];
+  };
+
+  explicit TrafficCapture(const std::string &path,
+                          std::size_t max_size = std::size_t(1) << 30)
+      : max_size_(max_size), start_(uv_hrtime()) {
+    fd_ = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+    if (fd_ < 0) uvcc::expr_throws(-errno);
+    FileHeader header = FileHeader();
+    std::memcpy(header.magic, magic(), sizeof(header.magic));
+    if (!_reserve(sizeof(header))) {
+      auto err = error_;
+      ::close(fd_);
+      uvcc::expr_throws(err);
+    }
+    _append(&header, sizeof(header));
+  }
+  TrafficCapture(const TrafficCapture &) = delete;
+  TrafficCapture &operator=(const TrafficCapture &) = delete;
+  ~TrafficCapture() { close(); }
+
+  /// Starts a new stream and returns its id for `record()`.
+  std::uint32_t open() _NOEXCEPT {
+    auto id = ++streams_;
+    record(Kind::kOpen, id);
+    return id;
+  }
+
+  void record(Kind kind, std::uint32_t stream, const uv_buf_t *bufs = nullptr,
+              unsigned int count = 0) _NOEXCEPT {
+    if (fd_ < 0) return;
+    std::size_t size = 0;
+    for (unsigned int i = 0; i < count; ++i) size += bufs[i].len;
+    auto padded = (size + 7) & ~std::size_t(7);
+    if (!_reserve(sizeof(RecordHeader) + padded)) {
+      ++dropped_;
+      return;
+    }
+    RecordHeader header = RecordHeader();
+    header.timestamp = uv_hrtime() - start_;
+    header.stream = stream;
+    header.size = static_cast<std::uint32_t>(size);
+    header.kind = kind;
+    _append(&header, sizeof(header));
+    for (unsigned int i = 0; i < count; ++i) _append(bufs[i].base, bufs[i].len);
+    length_ += padded - size;
+  }
+
+  void record(Kind kind, std::uint32_t stream, const char *data,
+              std::size_t size) _NOEXCEPT {
+    auto buf = uv_buf_init(const_cast<char *>(data),
+                           static_cast<unsigned int>(size));
+    record(kind, stream, &buf, 1);
+  }
+
+  /// Unmaps the file and trims it to the recorded length.
+  void close() _NOEXCEPT {
+    if (fd_ < 0) return;
+    _unmap();
+    if (::ftruncate(fd_, static_cast<off_t>(length_)) < 0)
+      uvcc::expr_cerr(uvcc::Exception(-errno));
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  static const char *magic() _NOEXCEPT { return "UVCCCAP1"; }
+
+  std::size_t size() const _NOEXCEPT { return length_; }
+
+  std::uint64_t droppedCount() const _NOEXCEPT { return dropped_; }
+
+ private:
+  static const std::size_t kWindowSize = 4 * 1024 * 1024;
+
+  int fd_ = -1;
+  std::size_t max_size_;
+  std::uint64_t start_;
+  std::size_t length_ = 0;
+  char *window_ = nullptr;
+  std::size_t window_offset_ = 0;
+  std::size_t window_size_ = 0;
+  std::uint32_t streams_ = 0;
+  std::uint64_t dropped_ = 0;
+  int error_ = 0;
+
+  /// Makes sure the window covers `size` more bytes.
+  bool _reserve(std::size_t size) _NOEXCEPT {
+    if (length_ + size > max_size_) return false;
+    if (window_ && length_ + size <= window_offset_ + window_size_) return true;
+    _unmap();
+    auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto offset = length_ & ~(page - 1);
+    auto window = kWindowSize;
+    while (window < length_ - offset + size) window <<= 1;
+    if (::ftruncate(fd_, static_cast<off_t>(offset + window)) < 0) {
+      error_ = -errno;
+      return false;
+    }
+    auto mapped = ::mmap(nullptr, window, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd_, static_cast<off_t>(offset));
+    if (mapped == MAP_FAILED) {
+      error_ = -errno;
+      return false;
+    }
+    window_ = static_cast<char *>(mapped);
+    window_offset_ = offset;
+    window_size_ = window;
+    return true;
+  }
+
+  void _append(const void *data, std::size_t size) _NOEXCEPT {
+    std::memcpy(window_ + (length_ - window_offset_), data, size);
+    length_ += size;
+  }
+
+  void _unmap() _NOEXCEPT {
+    if (!window_) return;
+    ::munmap(window_, window_size_);
+    window_ = nullptr;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // TRAFFICCAPTURE_H
@@ -0,0 +1,285 @@
+/// MIT License
+///
+/// uvcc/traffic-replay.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TRAFFICREPLAY_H
+#define TRAFFICREPLAY_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event-loop.h"
+#include "network.h"
+#include "stream.h"
+#include "traffic-capture.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Plays a `TrafficCapture` back against a server. Every captured stream
+/// becomes a new connection to `target` that sends what the stream read,
+/// at the captured offsets divided by `speed` (zero sends as fast as
+/// possible), and shuts down where the stream was closed. What the server
+/// sends back is read and counted.
+class TrafficReplay {
+ public:
+  struct Options {
+    double speed = 1.0;
+  };
+
+  struct Report {
+    std::size_t connections = 0;
+    std::size_t records = 0;
+    std::uint64_t sent = 0;
+    std::uint64_t received = 0;
+    std::size_t failed = 0;
+  };
+
+  using FinishingCompletionBlock = std::function<void(const Report &)>;
+
+  TrafficReplay(uvcc::EventLoop &loop, const std::string &path,
+                const network::Endpoint &target)
+      : TrafficReplay(loop, path, target, Options()) {}
+  TrafficReplay(uvcc::EventLoop &loop, const std::string &path,
+                const network::Endpoint &target, const Options &options)
+      : loop_(loop), target_(target), options_(options) {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) uvcc::expr_throws(-errno);
+    struct stat st;
+    auto err = ::fstat(fd, &st) < 0 ? -errno : 0;
+    size_ = err ? 0 : static_cast<std::size_t>(st.st_size);
+    if (!err && size_ < sizeof(TrafficCapture::FileHeader)) err = UV_EINVAL;
+    if (!err) {
+      auto mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED)
+        err = -errno;
+      else
+        data_ = static_cast<const char *>(mapped);
+    }
+    ::close(fd);
+    if (!err && std::memcmp(data_, TrafficCapture::magic(), 8)) err = UV_EINVAL;
+    if (err) {
+      if (data_) ::munmap(const_cast<char *>(data_), size_);
+      uvcc::expr_throws(err);
+    }
+    cursor_ = sizeof(TrafficCapture::FileHeader);
+    timer_ = new uv_timer_t();
+    uv_timer_init(loop.raw_.get(), timer_);
+    timer_->data = this;
+  }
+  TrafficReplay(const TrafficReplay &) = delete;
+  TrafficReplay &operator=(const TrafficReplay &) = delete;
+  ~TrafficReplay() {
+    uv_close(reinterpret_cast<uv_handle_t *>(timer_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_timer_t *>(handle);
+    });
+    connections_.clear();
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+
+  /// `block` runs once every record is played and every connection closed.
+  void start(FinishingCompletionBlock &&block) {
+    if (started_) uvcc::expr_throws(UV_EALREADY);
+    started_ = uv_hrtime();
+    finishing_block_ = std::move(block);
+    _advance();
+  }
+
+  const Report &report() const _NOEXCEPT { return report_; }
+
+ private:
+  struct Connection {
+    std::shared_ptr<uvcc::Stream> stream;
+    std::vector<uv_buf_t> pending;
+    bool connected = false;
+    bool closing = false;
+  };
+
+  uvcc::EventLoop &loop_;
+  network::Endpoint target_;
+  Options options_;
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t cursor_ = 0;
+  uv_timer_t *timer_ = nullptr;
+  std::uint64_t started_ = 0;
+  bool exhausted_ = false;
+  FinishingCompletionBlock finishing_block_;
+  std::unordered_map<std::uint32_t, std::shared_ptr<Connection>> connections_;
+  char scratch_[64 * 1024];
+  Report report_;
+
+  void _advance() {
+    auto elapsed = uv_hrtime() - started_;
+    TrafficCapture::RecordHeader header;
+    while (cursor_ + sizeof(header) <= size_) {
+      std::memcpy(&header, data_ + cursor_, sizeof(header));
+      auto payload = cursor_ + sizeof(header);
+      if (payload + header.size > size_) break;
+      if (options_.speed > 0) {
+        auto due = static_cast<std::uint64_t>(header.timestamp / options_.speed);
+        if (due > elapsed) {
+          uv_timer_start(
+              timer_,
+              [](uv_timer_t *handle) {
+                static_cast<TrafficReplay *>(handle->data)->_advance();
+              },
+              (due - elapsed + 999999) / 1000000, 0);
+          return;
+        }
+      }
+      cursor_ = payload + ((header.size + 7) & ~std::size_t(7));
+      ++report_.records;
+      _apply(header, data_ + payload);
+    }
+    exhausted_ = true;
+    _finishIfDone();
+  }
+
+  void _apply(const TrafficCapture::RecordHeader &header, const char *payload) {
+    switch (header.kind) {
+      case TrafficCapture::Kind::kOpen:
+        return _open(header.stream);
+      case TrafficCapture::Kind::kRead: {
+        auto it = connections_.find(header.stream);
+        if (it == connections_.end()) return;
+        auto buf = uv_buf_init(const_cast<char *>(payload), header.size);
+        if (!it->second->connected) return it->second->pending.push_back(buf);
+        return _write(it->second, buf);
+      }
+      case TrafficCapture::Kind::kClose: {
+        auto it = connections_.find(header.stream);
+        if (it == connections_.end()) return;
+        it->second->closing = true;
+        if (it->second->connected) _shutdown(header.stream, *it->second);
+        return;
+      }
+      default:
+        return;
+    }
+  }
+
+  void _open(std::uint32_t id) {
+    auto connection = std::make_shared<Connection>();
+    connection->stream =
+        std::make_shared<uvcc::Stream>(uvcc::Stream::TransmitType::kTCP);
+    std::weak_ptr<Connection> weak = connection;
+    try {
+      connection->stream->open(loop_);
+      connection->stream->connect(
+          target_.sockAddress(), [this, weak, id](uv_connect_t *, int status) {
+            auto connection = weak.lock();
+            if (!connection) return;
+            if (status < 0) return _fail(id);
+            _connected(id, connection);
+          });
+    } catch (const uvcc::Exception &exception) {
+      uvcc::expr_cerr(exception, UV_TCP);
+      ++report_.failed;
+      return;
+    }
+    connections_[id] = connection;
+    ++report_.connections;
+  }
+
+  void _connected(std::uint32_t id, const std::shared_ptr<Connection> &connection) {
+    connection->connected = true;
+    try {
+      connection->stream->startReading(
+          [this](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+            *buf = uv_buf_init(scratch_, sizeof(scratch_));
+          },
+          [this, id](uv_stream_t *, ssize_t nread, const uv_buf_t *) {
+            if (nread >= 0) {
+              report_.received += static_cast<std::uint64_t>(nread);
+              return;
+            }
+            if (nread != UV_EOF) return _fail(id);
+            _drop(id);
+          });
+    } catch (const uvcc::Exception &) {
+      return _fail(id);
+    }
+    auto pending = std::move(connection->pending);
+    for (auto &buf : pending) _write(connection, buf);
+    if (connection->closing) _shutdown(id, *connection);
+  }
+
+  void _write(const std::shared_ptr<Connection> &connection, const uv_buf_t &buf) {
+    std::weak_ptr<Connection> weak = connection;
+    auto size = buf.len;
+    try {
+      connection->stream->write(buf, [this, weak, size](uv_write_t *, int status) {
+        if (!weak.lock()) return;
+        if (status < 0)
+          ++report_.failed;
+        else
+          report_.sent += size;
+      });
+    } catch (const uvcc::Exception &) {
+      ++report_.failed;
+    }
+  }
+
+  void _shutdown(std::uint32_t id, Connection &connection) {
+    try {
+      connection.stream->shutdown();
+    } catch (const uvcc::Exception &) {
+      _drop(id);
+    }
+  }
+
+  void _fail(std::uint32_t id) {
+    ++report_.failed;
+    _drop(id);
+  }
+
+  void _drop(std::uint32_t id) {
+    connections_.erase(id);
+    _finishIfDone();
+  }
+
+  void _finishIfDone() {
+    if (!exhausted_ || !connections_.empty() || !finishing_block_) return;
+    auto block = std::move(finishing_block_);
+    finishing_block_ = nullptr;
+    block(report_);
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // TRAFFICREPLAY_H
@@ -0,0 +1,566 @@
+/// MIT License
+///
+/// uvcc/typed-handle.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TYPEDHANDLE_H
+#define TYPEDHANDLE_H
+
+#include <uv.h>
+
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "event-loop.h"
+#include "utilities.h"
+#include "write-coalescer.h"
+
+namespace uvcc {
+
+/// Callback table stored next to a handle of type `T`.
+template <typename T>
+struct HandleCallbacks {
+  std::function<void()> fired;
+};
+
+template <typename T>
+struct StreamHandleCallbacks {
+  std::function<uvcc::RawCompletionBlock<uv_alloc_cb>> allocating;
+  std::function<uvcc::RawCompletionBlock<uv_read_cb>> reading;
+  std::function<uvcc::RawCompletionBlock<uv_connection_cb>> receiving;
+};
+
+template <>
+struct HandleCallbacks<uv_tcp_t> : StreamHandleCallbacks<uv_tcp_t> {};
+
+template <>
+struct HandleCallbacks<uv_pipe_t> : StreamHandleCallbacks<uv_pipe_t> {};
+
+template <>
+struct HandleCallbacks<uv_tty_t> : StreamHandleCallbacks<uv_tty_t> {};
+
+template <>
+struct HandleCallbacks<uv_poll_t> {
+  std::function<void(int, int)> polled;
+};
+
+template <>
+struct HandleCallbacks<uv_signal_t> {
+  std::function<void(int)> signalled;
+};
+
+/// Heap storage of a typed handle: the libuv struct and nothing else of
+/// other handle types. `raw.data` points back at the box.
+template <typename T>
+struct HandleBox
+    : AllocationTracker::Tagged<AllocationTracker::Subsystem::kHandles> {
+  T raw;
+  HandleCallbacks<T> callbacks;
+  std::function<void()> closing;
+
+  static HandleBox *of(const void *handle) _NOEXCEPT {
+    return static_cast<HandleBox *>(
+        reinterpret_cast<const uv_handle_t *>(handle)->data);
+  }
+};
+
+/// Compile-time description of a libuv handle type: its `uv_handle_type`,
+/// whether it is a stream, and how it is initialised.
+template <typename T>
+struct HandleTraits;
+
+template <>
+struct HandleTraits<uv_tcp_t> {
+  static constexpr uv_handle_type type() { return UV_TCP; }
+  static constexpr bool isStream() { return true; }
+  static int init(uv_loop_t *loop, uv_tcp_t *handle) {
+    return uv_tcp_init(loop, handle);
+  }
+};
+
+template <>
+struct HandleTraits<uv_pipe_t> {
+  static constexpr uv_handle_type type() { return UV_NAMED_PIPE; }
+  static constexpr bool isStream() { return true; }
+  static int init(uv_loop_t *loop, uv_pipe_t *handle, bool ipc = false) {
+    return uv_pipe_init(loop, handle, ipc);
+  }
+};
+
+template <>
+struct HandleTraits<uv_tty_t> {
+  static constexpr uv_handle_type type() { return UV_TTY; }
+  static constexpr bool isStream() { return true; }
+  static int init(uv_loop_t *loop, uv_tty_t *handle, uv_file fd) {
+    return uv_tty_init(loop, handle, fd, 0);
+  }
+};
+
+template <>
+struct HandleTraits<uv_timer_t> {
+  static constexpr uv_handle_type type() { return UV_TIMER; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_timer_t *handle) {
+    return uv_timer_init(loop, handle);
+  }
+};
+
+template <>
+struct HandleTraits<uv_idle_t> {
+  static constexpr uv_handle_type type() { return UV_IDLE; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_idle_t *handle) {
+    return uv_idle_init(loop, handle);
+  }
+  static int start(uv_idle_t *handle, uv_idle_cb cb) {
+    return uv_idle_start(handle, cb);
+  }
+  static int stop(uv_idle_t *handle) { return uv_idle_stop(handle); }
+};
+
+template <>
+struct HandleTraits<uv_prepare_t> {
+  static constexpr uv_handle_type type() { return UV_PREPARE; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_prepare_t *handle) {
+    return uv_prepare_init(loop, handle);
+  }
+  static int start(uv_prepare_t *handle, uv_prepare_cb cb) {
+    return uv_prepare_start(handle, cb);
+  }
+  static int stop(uv_prepare_t *handle) { return uv_prepare_stop(handle); }
+};
+
+template <>
+struct HandleTraits<uv_check_t> {
+  static constexpr uv_handle_type type() { return UV_CHECK; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_check_t *handle) {
+    return uv_check_init(loop, handle);
+  }
+  static int start(uv_check_t *handle, uv_check_cb cb) {
+    return uv_check_start(handle, cb);
+  }
+  static int stop(uv_check_t *handle) { return uv_check_stop(handle); }
+};
+
+template <>
+struct HandleTraits<uv_async_t> {
+  static constexpr uv_handle_type type() { return UV_ASYNC; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_async_t *handle) {
+    return uv_async_init(loop, handle, [](uv_async_t *handle) {
+      auto &fired = HandleBox<uv_async_t>::of(handle)->callbacks.fired;
+      if (fired) fired();
+    });
+  }
+};
+
+template <>
+struct HandleTraits<uv_poll_t> {
+  static constexpr uv_handle_type type() { return UV_POLL; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_poll_t *handle, int fd) {
+    return uv_poll_init(loop, handle, fd);
+  }
+};
+
+template <>
+struct HandleTraits<uv_signal_t> {
+  static constexpr uv_handle_type type() { return UV_SIGNAL; }
+  static constexpr bool isStream() { return false; }
+  static int init(uv_loop_t *loop, uv_signal_t *handle) {
+    return uv_signal_init(loop, handle);
+  }
+};
+
+/// Handle wrapper resolved at compile time: it holds only a `T`, every call
+/// goes straight to the matching libuv function, and operations that `T`
+/// does not support are not declared for it. Destroying it closes the
+/// handle; the storage is freed from the close callback.
+///
+/// Once closed or moved from, operations that can fail throw `UV_EINVAL`
+/// and the others do nothing.
+template <typename T>
+class TypedHandle {
+  using Traits = HandleTraits<T>;
+  using Box = HandleBox<T>;
+
+  template <typename U>
+  using IfStream =
+      typename std::enable_if<HandleTraits<U>::isStream(), int>::type;
+  template <typename U, typename V>
+  using IfSame = typename std::enable_if<std::is_same<U, V>::value, int>::type;
+  template <typename U>
+  using IfWatcher = typename std::enable_if<
+      std::is_same<U, uv_idle_t>::value || std::is_same<U, uv_prepare_t>::value ||
+          std::is_same<U, uv_check_t>::value,
+      int>::type;
+
+ public:
+  using WritingCompletionBlock = uvcc::WriteCoalescer::WritingCompletionBlock;
+  using ConnectingCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_connect_cb>>;
+  using ShutdownCompletionBlock =
+      std::function<uvcc::RawCompletionBlock<uv_shutdown_cb>>;
+
+  template <typename... Ts>
+  explicit TypedHandle(uvcc::EventLoop &loop, Ts &&...params) {
+    std::unique_ptr<Box> box(new Box());
+    uvcc::expr_throws(
+        Traits::init(loop.raw_.get(), &box->raw, std::forward<Ts>(params)...));
+    box_ = box.release();
+    box_->raw.data = box_;
+  }
+  TypedHandle(const TypedHandle &) = delete;
+  TypedHandle &operator=(const TypedHandle &) = delete;
+  TypedHandle(TypedHandle &&other) _NOEXCEPT : box_(other.box_) {
+    other.box_ = nullptr;
+  }
+  TypedHandle &operator=(TypedHandle &&other) _NOEXCEPT {
+    if (&other != this) {
+      close();
+      box_ = other.box_;
+      other.box_ = nullptr;
+    }
+    return *this;
+  }
+  ~TypedHandle() { close(); }
+
+  static constexpr uv_handle_type type() { return Traits::type(); }
+
+  static constexpr std::size_t size() { return sizeof(T); }
+
+  /// `block` runs once libuv has released the handle.
+  void close(std::function<void()> &&block = {}) _NOEXCEPT {
+    if (!box_) return;
+    box_->closing = std::move(block);
+    uv_close(_handle(), [](uv_handle_t *handle) {
+      std::unique_ptr<Box> box(Box::of(handle));
+      auto closing = std::move(box->closing);
+      box.reset();
+      if (closing) closing();
+    });
+    box_ = nullptr;
+  }
+
+  bool isActive() const _NOEXCEPT {
+    return box_ && uv_is_active(_handle());
+  }
+
+  /// Also true once `close()` has released the handle.
+  bool isClosing() const _NOEXCEPT {
+    return !box_ || uv_is_closing(_handle());
+  }
+
+  void reference() _NOEXCEPT {
+    if (box_) uv_ref(_handle());
+  }
+
+  void unreference() _NOEXCEPT {
+    if (box_) uv_unref(_handle());
+  }
+
+  bool hasReference() const _NOEXCEPT {
+    return box_ && uv_has_ref(_handle());
+  }
+
+  // Streams.
+
+  template <typename U = T, IfStream<U> = 0>
+  void listen(int backlog, std::function<uvcc::RawCompletionBlock<
+                               uv_connection_cb>> &&block) {
+    _checkOpen();
+    box_->callbacks.receiving = std::move(block);
+    uvcc::expr_throws(uv_listen(_stream(), backlog,
+                                [](uv_stream_t *stream, int status) {
+                                  Box::of(stream)->callbacks.receiving(stream,
+                                                                       status);
+                                }),
+                      true);
+  }
+
+  template <typename U, typename V = T, IfStream<V> = 0, IfStream<U> = 0>
+  void accept(TypedHandle<U> &client) {
+    _checkOpen();
+    client._checkOpen();
+    uvcc::expr_throws(uv_accept(_stream(), client._stream()), true);
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  void startReading(
+      std::function<uvcc::RawCompletionBlock<uv_alloc_cb>> &&allocating,
+      std::function<uvcc::RawCompletionBlock<uv_read_cb>> &&reading) {
+    _checkOpen();
+    box_->callbacks.allocating = std::move(allocating);
+    box_->callbacks.reading = std::move(reading);
+    uvcc::expr_throws(
+        uv_read_start(
+            _stream(),
+            [](uv_handle_t *handle, std::size_t size, uv_buf_t *buf) {
+              Box::of(handle)->callbacks.allocating(handle, size, buf);
+            },
+            [](uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
+              Box::of(stream)->callbacks.reading(stream, nread, buf);
+            }),
+        true);
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  void stopReading() _NOEXCEPT {
+    if (box_) uv_read_stop(_stream());
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  void write(const uv_buf_t *bufs, unsigned int count,
+             WritingCompletionBlock &&block = {}) {
+    _checkOpen();
+    std::vector<WritingCompletionBlock> blocks(1, std::move(block));
+    uvcc::expr_throws(
+        uvcc::WriteCoalescer::submit(_stream(), bufs, count, blocks));
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  int tryWrite(const uv_buf_t *bufs, unsigned int count) _NOEXCEPT {
+    return box_ ? uv_try_write(_stream(), bufs, count) : UV_EINVAL;
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  void shutdown(ShutdownCompletionBlock &&block = {}) {
+    _checkOpen();
+    auto request = new Request<uv_shutdown_t, ShutdownCompletionBlock>();
+    request->block = std::move(block);
+    auto err = uv_shutdown(&request->raw, _stream(),
+                           &Request<uv_shutdown_t, ShutdownCompletionBlock>::complete);
+    if (err) delete request;
+    uvcc::expr_throws(err, true);
+  }
+
+  template <typename U = T, IfStream<U> = 0>
+  std::size_t writeQueueSize() const _NOEXCEPT {
+    return box_ ? uv_stream_get_write_queue_size(_stream()) : 0;
+  }
+
+  // TCP.
+
+  template <typename U = T, IfSame<U, uv_tcp_t> = 0>
+  void bind(const sockaddr *address, unsigned int flags = 0) {
+    _checkOpen();
+    uvcc::expr_throws(uv_tcp_bind(&box_->raw, address, flags), true);
+  }
+
+  template <typename U = T, IfSame<U, uv_tcp_t> = 0>
+  void connect(const sockaddr *address, ConnectingCompletionBlock &&block = {}) {
+    _checkOpen();
+    auto request = new Request<uv_connect_t, ConnectingCompletionBlock>();
+    request->block = std::move(block);
+    auto err = uv_tcp_connect(
+        &request->raw, &box_->raw, address,
+        &Request<uv_connect_t, ConnectingCompletionBlock>::complete);
+    if (err) delete request;
+    uvcc::expr_throws(err, true);
+  }
+
+  template <typename U = T, IfSame<U, uv_tcp_t> = 0>
+  void setNoDelay(bool enabled) {
+    _checkOpen();
+    uvcc::expr_throws(uv_tcp_nodelay(&box_->raw, enabled), true);
+  }
+
+  // Named pipes.
+
+  template <typename U = T, IfSame<U, uv_pipe_t> = 0>
+  void open(uv_file fd) {
+    _checkOpen();
+    uvcc::expr_throws(uv_pipe_open(&box_->raw, fd), true);
+  }
+
+  template <typename U = T, IfSame<U, uv_pipe_t> = 0>
+  void bind(const std::string &name) {
+    _checkOpen();
+    uvcc::expr_throws(uv_pipe_bind(&box_->raw, name.c_str()), true);
+  }
+
+  template <typename U = T, IfSame<U, uv_pipe_t> = 0>
+  void connect(const std::string &name, ConnectingCompletionBlock &&block = {}) {
+    _checkOpen();
+    auto request = new Request<uv_connect_t, ConnectingCompletionBlock>();
+    request->block = std::move(block);
+    uv_pipe_connect(&request->raw, &box_->raw, name.c_str(),
+                    &Request<uv_connect_t, ConnectingCompletionBlock>::complete);
+  }
+
+  // Timers.
+
+  template <typename U = T, IfSame<U, uv_timer_t> = 0>
+  void start(std::uint64_t timeout, std::uint64_t repeat,
+             std::function<void()> &&block) {
+    _checkOpen();
+    box_->callbacks.fired = std::move(block);
+    uvcc::expr_throws(uv_timer_start(&box_->raw,
+                                     [](uv_timer_t *handle) {
+                                       Box::of(handle)->callbacks.fired();
+                                     },
+                                     timeout, repeat),
+                      true);
+  }
+
+  template <typename U = T, IfSame<U, uv_timer_t> = 0>
+  void again() {
+    _checkOpen();
+    uvcc::expr_throws(uv_timer_again(&box_->raw), true);
+  }
+
+  template <typename U = T, IfSame<U, uv_timer_t> = 0>
+  void setRepeat(std::uint64_t repeat) _NOEXCEPT {
+    if (box_) uv_timer_set_repeat(&box_->raw, repeat);
+  }
+
+  template <typename U = T, IfSame<U, uv_timer_t> = 0>
+  void stop() _NOEXCEPT {
+    if (box_) uv_timer_stop(&box_->raw);
+  }
+
+  // Idle, prepare and check watchers.
+
+  template <typename U = T, IfWatcher<U> = 0>
+  void start(std::function<void()> &&block) {
+    _checkOpen();
+    box_->callbacks.fired = std::move(block);
+    uvcc::expr_throws(
+        Traits::start(&box_->raw,
+                      [](T *handle) { Box::of(handle)->callbacks.fired(); }),
+        true);
+  }
+
+  template <typename U = T, IfWatcher<U> = 0>
+  void stop() _NOEXCEPT {
+    if (box_) Traits::stop(&box_->raw);
+  }
+
+  // Async.
+
+  /// Sets what runs on the loop after `send()`; call before sharing.
+  template <typename U = T, IfSame<U, uv_async_t> = 0>
+  void onSend(std::function<void()> &&block) {
+    _checkOpen();
+    box_->callbacks.fired = std::move(block);
+  }
+
+  /// Thread-safe wake-up; sends before the callback runs are coalesced.
+  template <typename U = T, IfSame<U, uv_async_t> = 0>
+  void send() {
+    _checkOpen();
+    uvcc::expr_throws(uv_async_send(&box_->raw), true);
+  }
+
+  // Poll.
+
+  template <typename U = T, IfSame<U, uv_poll_t> = 0>
+  void start(int events, std::function<void(int, int)> &&block) {
+    _checkOpen();
+    box_->callbacks.polled = std::move(block);
+    uvcc::expr_throws(
+        uv_poll_start(&box_->raw, events,
+                      [](uv_poll_t *handle, int status, int events) {
+                        Box::of(handle)->callbacks.polled(status, events);
+                      }),
+        true);
+  }
+
+  template <typename U = T, IfSame<U, uv_poll_t> = 0>
+  void stop() _NOEXCEPT {
+    if (box_) uv_poll_stop(&box_->raw);
+  }
+
+  // Signals.
+
+  template <typename U = T, IfSame<U, uv_signal_t> = 0>
+  void start(int signum, std::function<void(int)> &&block) {
+    _checkOpen();
+    box_->callbacks.signalled = std::move(block);
+    uvcc::expr_throws(uv_signal_start(&box_->raw,
+                                      [](uv_signal_t *handle, int signum) {
+                                        Box::of(handle)->callbacks.signalled(
+                                            signum);
+                                      },
+                                      signum),
+                      true);
+  }
+
+  template <typename U = T, IfSame<U, uv_signal_t> = 0>
+  void stop() _NOEXCEPT {
+    if (box_) uv_signal_stop(&box_->raw);
+  }
+
+ protected:
+  template <typename>
+  friend class TypedHandle;
+
+  /// Request context freed by its own completion callback.
+  template <typename R, typename Block>
+  struct Request
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kRequests> {
+    R raw;
+    Block block;
+
+    template <typename... Ts>
+    static void complete(R *request, Ts... params) {
+      std::unique_ptr<Request> context(reinterpret_cast<Request *>(request));
+      if (context->block) context->block(request, params...);
+    }
+  };
+
+  Box *box_ = nullptr;
+
+  /// Throws UV_EINVAL once the handle is closed or moved from.
+  void _checkOpen() const {
+    if (!box_) uvcc::expr_throws(UV_EINVAL);
+  }
+
+  uv_handle_t *_handle() const _NOEXCEPT {
+    return reinterpret_cast<uv_handle_t *>(&box_->raw);
+  }
+
+  uv_stream_t *_stream() const _NOEXCEPT {
+    return reinterpret_cast<uv_stream_t *>(&box_->raw);
+  }
+};
+
+using TCPHandle = TypedHandle<uv_tcp_t>;
+using PipeHandle = TypedHandle<uv_pipe_t>;
+using TTYHandle = TypedHandle<uv_tty_t>;
+using TimerHandle = TypedHandle<uv_timer_t>;
+using IdleHandle = TypedHandle<uv_idle_t>;
+using PrepareHandle = TypedHandle<uv_prepare_t>;
+using CheckHandle = TypedHandle<uv_check_t>;
+using AsyncHandle = TypedHandle<uv_async_t>;
+using PollHandle = TypedHandle<uv_poll_t>;
+using SignalHandle = TypedHandle<uv_signal_t>;
+
+}  // namespace uvcc
+
+#endif  // TYPEDHANDLE_H
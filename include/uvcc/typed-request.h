@@ -0,0 +1,280 @@
+/// MIT License
+///
+/// uvcc/typed-request.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef TYPEDREQUEST_H
+#define TYPEDREQUEST_H
+
+#include <uv.h>
+
+#include <functional>
+#include <type_traits>
+
+#include "event-loop.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Compile-time description of a libuv request type.
+template <typename T>
+struct RequestTraits;
+
+template <>
+struct RequestTraits<uv_connect_t> {
+  static constexpr uv_req_type type() { return UV_CONNECT; }
+  static constexpr bool isCancellable() { return false; }
+};
+
+template <>
+struct RequestTraits<uv_write_t> {
+  static constexpr uv_req_type type() { return UV_WRITE; }
+  static constexpr bool isCancellable() { return false; }
+};
+
+template <>
+struct RequestTraits<uv_shutdown_t> {
+  static constexpr uv_req_type type() { return UV_SHUTDOWN; }
+  static constexpr bool isCancellable() { return false; }
+};
+
+template <>
+struct RequestTraits<uv_udp_send_t> {
+  static constexpr uv_req_type type() { return UV_UDP_SEND; }
+  static constexpr bool isCancellable() { return false; }
+};
+
+template <>
+struct RequestTraits<uv_fs_t> {
+  static constexpr uv_req_type type() { return UV_FS; }
+  static constexpr bool isCancellable() { return true; }
+};
+
+template <>
+struct RequestTraits<uv_work_t> {
+  static constexpr uv_req_type type() { return UV_WORK; }
+  static constexpr bool isCancellable() { return true; }
+};
+
+template <>
+struct RequestTraits<uv_getaddrinfo_t> {
+  static constexpr uv_req_type type() { return UV_GETADDRINFO; }
+  static constexpr bool isCancellable() { return true; }
+};
+
+template <>
+struct RequestTraits<uv_getnameinfo_t> {
+  static constexpr uv_req_type type() { return UV_GETNAMEINFO; }
+  static constexpr bool isCancellable() { return true; }
+};
+
+template <>
+struct RequestTraits<uv_random_t> {
+  static constexpr uv_req_type type() { return UV_RANDOM; }
+  static constexpr bool isCancellable() { return true; }
+};
+
+/// Request wrapper resolved at compile time. It holds only a `T`, in
+/// storage that outlives the wrapper while the request is in flight, and
+/// `cancel()` exists only for the request types libuv can cancel.
+///
+/// With a timeout set, a request still queued at its deadline is cancelled
+/// and one already running completes early with `UV_ETIMEDOUT`; its late
+/// result is then discarded.
+template <typename T>
+class TypedRequest {
+  using Traits = RequestTraits<T>;
+
+  template <typename U>
+  using IfCancellable =
+      typename std::enable_if<RequestTraits<U>::isCancellable(), int>::type;
+  template <typename U, typename V>
+  using IfSame = typename std::enable_if<std::is_same<U, V>::value, int>::type;
+
+ public:
+  using WorkingCompletionBlock = std::function<void()>;
+  using AfterWorkingCompletionBlock = std::function<void(int)>;
+  using ResolvingCompletionBlock = std::function<void(int, addrinfo *)>;
+  /// Gets the request's result and the request, which is null on timeout.
+  using FileCompletionBlock = std::function<void(ssize_t, uv_fs_t *)>;
+  using FileStartingBlock = std::function<int(uv_loop_t *, uv_fs_t *, uv_fs_cb)>;
+
+  TypedRequest() = default;
+  TypedRequest(const TypedRequest &) = delete;
+  TypedRequest &operator=(const TypedRequest &) = delete;
+  ~TypedRequest() {
+    if (box_) box_->owner = nullptr;
+  }
+
+  static constexpr uv_req_type type() { return Traits::type(); }
+
+  static constexpr std::size_t size() { return sizeof(T); }
+
+  bool isPending() const _NOEXCEPT { return box_ != nullptr; }
+
+  /// Deadline in milliseconds for requests submitted afterwards; 0 for none.
+  /// A request that times out while running completes before the pool
+  /// thread is done with it: its `work` closure, or the buffers a `uv_fs_*`
+  /// call was given, are still in use until the late result is discarded.
+  void setTimeout(std::uint64_t timeout) _NOEXCEPT { timeout_ = timeout; }
+
+  std::uint64_t timeout() const _NOEXCEPT { return timeout_; }
+
+  template <typename U = T, IfCancellable<U> = 0>
+  void cancel() {
+    if (!box_) uvcc::expr_throws(UV_EINVAL);
+    uvcc::expr_throws(
+        uv_cancel(reinterpret_cast<uv_req_t *>(&box_->raw)), true);
+  }
+
+  /// Runs `work` on the thread pool, then `after` on the loop with 0 or
+  /// `UV_ECANCELED`.
+  template <typename U = T, IfSame<U, uv_work_t> = 0>
+  void queue(uvcc::EventLoop &loop, WorkingCompletionBlock &&work,
+             AfterWorkingCompletionBlock &&after) {
+    auto box = _box(loop);
+    box->work = std::move(work);
+    box->after = std::move(after);
+    _submit(box, uv_queue_work(
+                     loop.raw_.get(), &box->raw,
+                     [](uv_work_t *request) {
+                       auto box = static_cast<Box *>(request->data);
+                       if (box->tracer)
+                         box->tracer->requestStarted(request, UV_WORK);
+                       box->work();
+                     },
+                     [](uv_work_t *request, int status) {
+                       std::unique_ptr<Box> box(
+                           static_cast<Box *>(request->data));
+                       if (_finish(box.get(), status) && box->after)
+                         box->after(status);
+                     }));
+  }
+
+  /// Resolves `node` / `service` on the thread pool; `block` owns nothing,
+  /// the list is freed when it returns.
+  template <typename U = T, IfSame<U, uv_getaddrinfo_t> = 0>
+  void resolve(uvcc::EventLoop &loop, const char *node, const char *service,
+               const addrinfo *hints, ResolvingCompletionBlock &&block) {
+    auto box = _box(loop);
+    box->resolving = std::move(block);
+    _submit(box, uv_getaddrinfo(
+                     loop.raw_.get(), &box->raw,
+                     [](uv_getaddrinfo_t *request, int status, addrinfo *res) {
+                       std::unique_ptr<Box> box(
+                           static_cast<Box *>(request->data));
+                       if (_finish(box.get(), status) && box->resolving)
+                         box->resolving(status, res);
+                       uv_freeaddrinfo(res);
+                     },
+                     node, service, hints));
+  }
+
+  /// Starts a `uv_fs_*` call through `start`, which gets the loop, the
+  /// request and the callback to pass on. The request is cleaned up after
+  /// `block` returns.
+  template <typename U = T, IfSame<U, uv_fs_t> = 0>
+  void fs(uvcc::EventLoop &loop, FileStartingBlock &&start,
+          FileCompletionBlock &&block) {
+    auto box = _box(loop);
+    box->filing = std::move(block);
+    _submit(box, start(loop.raw_.get(), &box->raw, [](uv_fs_t *request) {
+      std::unique_ptr<Box> box(static_cast<Box *>(request->data));
+      auto result = static_cast<int>(request->result);
+      if (_finish(box.get(), result) && box->filing)
+        box->filing(result == UV_ETIMEDOUT ? result : request->result,
+                    request);
+      uv_fs_req_cleanup(request);
+    }));
+  }
+
+ private:
+  struct Box
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kRequests> {
+    T raw;
+    TypedRequest *owner;
+    uvcc::EventLoop *loop;
+    uvcc::Tracer *tracer;
+    WorkingCompletionBlock work;
+    AfterWorkingCompletionBlock after;
+    ResolvingCompletionBlock resolving;
+    FileCompletionBlock filing;
+    bool armed = false;
+    bool timed_out = false;
+    bool finished = false;
+  };
+
+  Box *box_ = nullptr;
+  std::uint64_t timeout_ = 0;
+
+  std::unique_ptr<Box> _box(uvcc::EventLoop &loop) {
+    if (box_) uvcc::expr_throws(UV_EBUSY);
+    std::unique_ptr<Box> box(new Box());
+    box->owner = this;
+    box->loop = &loop;
+    box->tracer = loop.tracer_;
+    box->raw.data = box.get();
+    if (box->tracer) box->tracer->requestSubmitted(&box->raw, type());
+    return box;
+  }
+
+  void _submit(std::unique_ptr<Box> &box, int err) {
+    if (err && box->tracer) box->tracer->requestCompleted(&box->raw, type());
+    uvcc::expr_throws(err, true);
+    box_ = box.release();
+    if (!timeout_) return;
+    auto raw = box_;
+    raw->armed = true;
+    box_->loop->throttle().defer(raw, timeout_, [raw] { _expire(raw); });
+  }
+
+  /// Cancels a queued request; completes a running one now.
+  static void _expire(Box *box) {
+    box->timed_out = true;
+    if (!uv_cancel(reinterpret_cast<uv_req_t *>(&box->raw))) return;
+    box->finished = true;
+    if (box->owner) box->owner->box_ = nullptr;
+    box->owner = nullptr;
+    if (box->after) box->after(UV_ETIMEDOUT);
+    if (box->resolving) box->resolving(UV_ETIMEDOUT, nullptr);
+    if (box->filing) box->filing(UV_ETIMEDOUT, nullptr);
+  }
+
+  /// Settles a completed request; false when its result is to be dropped.
+  static bool _finish(Box *box, int &status) _NOEXCEPT {
+    if (box->tracer) box->tracer->requestCompleted(&box->raw, type());
+    if (box->armed && !box->timed_out) box->loop->throttle().cancel(box);
+    if (box->finished) return false;
+    if (box->owner) box->owner->box_ = nullptr;
+    if (box->timed_out) status = UV_ETIMEDOUT;
+    return true;
+  }
+};
+
+using WorkRequest = TypedRequest<uv_work_t>;
+
+}  // namespace uvcc
+
+#endif  // TYPEDREQUEST_H
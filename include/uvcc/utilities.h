@@ -29,9 +29,9 @@
 
 #include <uv.h>
 
-#include <iostream>
-
+#include "allocation-tracker.h"
 #include "exception.h"
+#include "logger.h"
 
 namespace uvcc {
 
@@ -106,13 +106,15 @@ inline bool expr_assert(int err, bool abs = false) _NOEXCEPT {
   return abs ? (err == 0) : (err >= 0);
 }
 
-inline void expr_cerr(const uvcc::Exception &exception) _NOEXCEPT {
-  std::cerr << exception.what() << std::endl;
+inline void expr_cerr(const uvcc::Exception &exception,
+                      uv_handle_type handle_type = UV_UNKNOWN_HANDLE) _NOEXCEPT {
+  uvcc::Logger::shared().error(exception, handle_type);
 }
 
-inline bool expr_cerr_r(int err, bool abs = false) _NOEXCEPT {
+inline bool expr_cerr_r(int err, bool abs = false,
+                        uv_handle_type handle_type = UV_UNKNOWN_HANDLE) _NOEXCEPT {
   if (expr_assert(err, abs)) return true;
-  expr_cerr(uvcc::Exception(err));
+  expr_cerr(uvcc::Exception(err), handle_type);
   return false;
 }
 
@@ -131,6 +133,18 @@ enum class RunOption : int {
   kNoWait = UV_RUN_NOWAIT,
 };
 
+/// Subsystem that `BaseObject` storage of `T` is counted under.
+template <typename T>
+constexpr AllocationTracker::Subsystem storage_subsystem() _NOEXCEPT {
+  return std::is_same<T, uv_any_handle>::value ||
+                 std::is_same<T, uv_handle_t>::value ||
+                 std::is_same<T, uv_loop_t>::value
+             ? AllocationTracker::Subsystem::kHandles
+         : std::is_same<T, uv_any_req>::value || std::is_same<T, uv_req_t>::value
+             ? AllocationTracker::Subsystem::kRequests
+             : AllocationTracker::Subsystem::kOther;
+}
+
 template <typename Type, typename UnionType = void,
           typename std::enable_if<std::is_union<UnionType>::value ||
                                       (std::is_void<UnionType>::value &&
@@ -141,16 +155,17 @@ class BaseObject {
   using Self = typename std::conditional<std::is_void<UnionType>::value, Type,
                                          UnionType>::type;
   using UnionSelf = UnionType;
+  using Storage = std::unique_ptr<Self, AllocationTracker::Deleter<Self>>;
 
-  BaseObject() : raw_(uvcc::make_unique<Self>()) {}
-  BaseObject(const Self &self) : raw_(uvcc::make_unique<Self>(self)) {}
-  BaseObject(Self &&self) _NOEXCEPT : raw_(uvcc::make_unique<Self>(self)) {}
+  BaseObject() : raw_(_makeRaw()) {}
+  BaseObject(const Self &self) : raw_(_makeRaw(self)) {}
+  BaseObject(Self &&self) _NOEXCEPT : raw_(_makeRaw(self)) {}
   //  BaseObject(const BaseObject &) = default;
   BaseObject(BaseObject &&) _NOEXCEPT = default;
   //  BaseObject &operator=(const BaseObject &) = default;
   BaseObject &operator=(BaseObject &&) _NOEXCEPT = default;
   BaseObject &operator=(const Self &self) {
-    if (&self != this->_someRaw()) raw_ = uvcc::make_unique<Self>(self);
+    if (&self != this->_someRaw()) raw_ = _makeRaw(self);
     return *this;
   }
   BaseObject &operator=(Self &&self) _NOEXCEPT {
@@ -160,7 +175,13 @@ class BaseObject {
   virtual ~BaseObject() = default;
 
  protected:
-  std::unique_ptr<Self> raw_ = 0;
+  Storage raw_ = 0;
+
+  template <typename... Ts>
+  static Storage _makeRaw(Ts &&...params) {
+    return Storage(AllocationTracker::create<Self>(
+        uvcc::storage_subsystem<Self>(), std::forward<Ts>(params)...));
+  }
 
   template <typename RawValuePointer = typename std::add_pointer<Type>::type,
             typename std::enable_if<std::is_pointer<RawValuePointer>::value,
@@ -0,0 +1,83 @@
+/// MIT License
+///
+/// uvcc/view.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <cstring>
+#include <string>
+
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Non-owning slice of a read buffer.
+class View {
+ public:
+  View() = default;
+  View(const char *data, std::size_t size) _NOEXCEPT : data_(data),
+                                                        size_(size) {}
+
+  const char *data() const _NOEXCEPT { return data_; }
+
+  std::size_t size() const _NOEXCEPT { return size_; }
+
+  bool isEmpty() const _NOEXCEPT { return size_ == 0; }
+
+  std::string toString() const { return std::string(data_, size_); }
+
+  bool equals(const char *literal) const _NOEXCEPT {
+    return std::strlen(literal) == size_ &&
+           std::memcmp(data_, literal, size_) == 0;
+  }
+
+  bool equalsIgnoringCase(const char *literal) const _NOEXCEPT {
+    std::size_t i = 0;
+    for (; i < size_ && literal[i]; ++i)
+      if (_lower(data_[i]) != _lower(literal[i])) return false;
+    return i == size_ && !literal[i];
+  }
+
+  bool containsIgnoringCase(const char *literal) const _NOEXCEPT {
+    auto length = std::strlen(literal);
+    for (std::size_t i = 0; i + length <= size_; ++i)
+      if (View(data_ + i, length).equalsIgnoringCase(literal)) return true;
+    return false;
+  }
+
+ private:
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+
+  static char _lower(char c) _NOEXCEPT {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // VIEW_H
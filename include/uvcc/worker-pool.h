@@ -0,0 +1,394 @@
+/// MIT License
+///
+/// uvcc/worker-pool.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <netdb.h>
+#include <uv.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "event-loop.h"
+#include "request.h"
+#include "task-scheduler.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Fixed set of threads owned by uvcc rather than libuv's shared pool.
+/// Jobs are taken highest priority first, in order within a priority, and
+/// their completions run on the loop thread.
+class WorkerPool {
+ public:
+  using Priority = uvcc::TaskScheduler::Priority;
+  using WorkingCompletionBlock = std::function<void()>;
+  using AfterWorkingCompletionBlock = std::function<void(int)>;
+
+  struct Metrics {
+    std::size_t threads = 0;
+    std::size_t queued = 0;
+    std::size_t max_queued = 0;
+    std::size_t running = 0;
+    std::uint64_t submitted = 0;
+    std::uint64_t completed = 0;
+    std::uint64_t cancelled = 0;
+    /// Time jobs spent queued, in microseconds.
+    std::uint64_t total_wait = 0;
+    std::uint64_t max_wait = 0;
+
+    std::uint64_t meanWait() const _NOEXCEPT {
+      auto started = completed + running;
+      return started ? total_wait / started : 0;
+    }
+  };
+
+  /// `niceness` is applied to the threads where supported; raising
+  /// priority above the process's usually needs privileges and is skipped
+  /// when refused.
+  WorkerPool(uv_loop_t *loop, std::size_t threads, int niceness = 0)
+      : async_(new uv_async_t()) {
+    uv_async_init(loop, async_, [](uv_async_t *handle) {
+      static_cast<WorkerPool *>(handle->data)->_drain();
+    });
+    async_->data = this;
+    uv_unref(reinterpret_cast<uv_handle_t *>(async_));
+    metrics_.threads = threads ? threads : 1;
+    for (std::size_t i = 0; i < metrics_.threads; ++i)
+      threads_.emplace_back([this, niceness] { _run(niceness); });
+  }
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+  /// Waits for running jobs; queued ones complete with `UV_ECANCELED`.
+  ~WorkerPool() {
+    std::deque<Job> abandoned;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      for (auto &queue : queues_) {
+        for (auto &job : queue) abandoned.push_back(std::move(job));
+        queue.clear();
+      }
+      metrics_.cancelled += abandoned.size();
+      metrics_.queued = 0;
+    }
+    ready_.notify_all();
+    for (auto &thread : threads_) thread.join();
+    _drain();
+    for (auto &job : abandoned)
+      if (job.after) job.after(UV_ECANCELED);
+    uv_close(reinterpret_cast<uv_handle_t *>(async_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_async_t *>(handle);
+    });
+  }
+
+  /// Runs `work` on a pool thread, then `after` on the loop with 0, or with
+  /// `UV_ECANCELED` if the pool goes away first.
+  void submit(WorkingCompletionBlock &&work, AfterWorkingCompletionBlock &&after,
+              const Priority &priority = Priority::kNormal) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queues_[static_cast<int>(priority)].push_back(
+          Job{std::move(work), std::move(after), uv_hrtime()});
+      ++metrics_.submitted;
+      metrics_.max_queued = std::max(++metrics_.queued, metrics_.max_queued);
+    }
+    if (outstanding_++ == 0) uv_ref(reinterpret_cast<uv_handle_t *>(async_));
+    ready_.notify_one();
+  }
+
+  Metrics metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_;
+  }
+
+ private:
+  struct Job {
+    WorkingCompletionBlock work;
+    AfterWorkingCompletionBlock after;
+    std::uint64_t queued_at;
+  };
+
+  uv_async_t *async_;
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Job> queues_[3];
+  std::vector<AfterWorkingCompletionBlock> done_;
+  Metrics metrics_;
+  std::size_t outstanding_ = 0;
+  bool stopping_ = false;
+
+  void _run(int niceness) {
+#if defined(__linux__)
+    if (niceness)
+      setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                  niceness);
+#else
+    (void)niceness;
+#endif
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      ready_.wait(lock, [this] {
+        return stopping_ || !queues_[0].empty() || !queues_[1].empty() ||
+               !queues_[2].empty();
+      });
+      if (stopping_) return;
+      auto queue = queues_;
+      while (queue->empty()) ++queue;
+      auto job = std::move(queue->front());
+      queue->pop_front();
+      auto wait = (uv_hrtime() - job.queued_at) / 1000;
+      --metrics_.queued;
+      ++metrics_.running;
+      metrics_.total_wait += wait;
+      metrics_.max_wait = std::max(metrics_.max_wait, wait);
+      lock.unlock();
+      if (job.work) job.work();
+      lock.lock();
+      --metrics_.running;
+      ++metrics_.completed;
+      done_.push_back(std::move(job.after));
+      uv_async_send(async_);
+    }
+  }
+
+  void _drain() {
+    std::vector<AfterWorkingCompletionBlock> done;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done.swap(done_);
+    }
+    for (auto &after : done) {
+      if (--outstanding_ == 0)
+        uv_unref(reinterpret_cast<uv_handle_t *>(async_));
+      if (after) after(0);
+    }
+  }
+};
+
+/// Separate `WorkerPool`s for the thread-pool request classes, so a burst
+/// of one kind of blocking work cannot hold up the others. Pools start on
+/// first use with `configure()`'s settings; it must outlive none of its
+/// jobs' completions and be destroyed before the loop.
+class WorkerPools {
+ public:
+  using Priority = WorkerPool::Priority;
+  using ResolvingCompletionBlock = std::function<void(int, addrinfo *)>;
+  using FileCompletionBlock = std::function<void(ssize_t, uv_fs_t *)>;
+  using FileStartingBlock = std::function<int(uv_loop_t *, uv_fs_t *)>;
+
+  explicit WorkerPools(uvcc::EventLoop &loop) : loop_(&loop) {
+    configure(Request::TransmitType::kFS, 4, Priority::kNormal);
+    configure(Request::TransmitType::kWork, 4, Priority::kNormal);
+    configure(Request::TransmitType::kGetAddrInfo, 2, Priority::kHigh);
+    configure(Request::TransmitType::kRandom, 1, Priority::kLow);
+  }
+  WorkerPools(const WorkerPools &) = delete;
+  WorkerPools &operator=(const WorkerPools &) = delete;
+
+  /// Sizes a class and sets its threads' scheduling priority; applies
+  /// when its pool starts.
+  void configure(const Request::TransmitType &type, std::size_t threads,
+                 const Priority &priority) {
+    auto &entry = classes_[_index(type)];
+    if (entry.pool) uvcc::expr_throws(UV_EBUSY);
+    entry.threads = threads;
+    entry.priority = priority;
+  }
+
+  WorkerPool &pool(const Request::TransmitType &type) {
+    auto &entry = classes_[_index(type)];
+    if (!entry.pool)
+      entry.pool = uvcc::make_unique<WorkerPool>(
+          loop_->raw_.get(), entry.threads, _niceness(entry.priority));
+    return *entry.pool;
+  }
+
+  WorkerPool::Metrics metrics(const Request::TransmitType &type) {
+    auto &entry = classes_[_index(type)];
+    return entry.pool ? entry.pool->metrics() : WorkerPool::Metrics();
+  }
+
+  /// Jobs are traced as requests of `type` while the loop has a tracer.
+  void submit(const Request::TransmitType &type,
+              WorkerPool::WorkingCompletionBlock &&work,
+              WorkerPool::AfterWorkingCompletionBlock &&after,
+              const Priority &priority = Priority::kNormal) {
+    if (auto tracer = loop_->tracer_) {
+      auto raw = static_cast<uv_req_type>(type);
+      auto token = std::make_shared<char>();
+      tracer->requestSubmitted(token.get(), raw);
+      work = [tracer, raw, token, work] {
+        tracer->requestStarted(token.get(), raw);
+        if (work) work();
+      };
+      after = [tracer, raw, token, after](int status) {
+        tracer->requestCompleted(token.get(), raw);
+        if (after) after(status);
+      };
+    }
+    pool(type).submit(std::move(work), std::move(after), priority);
+  }
+
+  /// Resolves on the `kGetAddrInfo` pool; the list is freed after `block`.
+  void resolve(const std::string &node, const std::string &service,
+               const addrinfo *hints, ResolvingCompletionBlock &&block,
+               const Priority &priority = Priority::kNormal) {
+    struct Context {
+      addrinfo *res = nullptr;
+      int status = 0;
+    };
+    auto context = std::make_shared<Context>();
+    std::shared_ptr<addrinfo> copy;
+    if (hints) copy = std::make_shared<addrinfo>(*hints);
+    submit(
+        Request::TransmitType::kGetAddrInfo,
+        [context, node, service, copy] {
+          auto err = getaddrinfo(node.empty() ? nullptr : node.c_str(),
+                                 service.empty() ? nullptr : service.c_str(),
+                                 copy.get(), &context->res);
+          context->status = _translate(err);
+          if (err) context->res = nullptr;
+        },
+        [context, block](int status) {
+          if (block) block(status ? status : context->status, context->res);
+          if (context->res) freeaddrinfo(context->res);
+        },
+        priority);
+  }
+
+  /// Runs a synchronous `uv_fs_*` call on the `kFS` pool: `start` gets the
+  /// loop and request and must pass a null callback. The request is
+  /// cleaned up after `block`.
+  void fs(FileStartingBlock &&start, FileCompletionBlock &&block,
+          const Priority &priority = Priority::kNormal) {
+    auto request = std::make_shared<uv_fs_t>();
+    auto loop = loop_->raw_.get();
+    auto starting = std::make_shared<FileStartingBlock>(std::move(start));
+    submit(
+        Request::TransmitType::kFS,
+        [request, loop, starting] { (*starting)(loop, request.get()); },
+        [request, block](int status) {
+          if (block)
+            block(status ? status : request->result,
+                  status ? nullptr : request.get());
+          if (!status) uv_fs_req_cleanup(request.get());
+        },
+        priority);
+  }
+
+ private:
+  struct Class {
+    std::size_t threads = 1;
+    Priority priority = Priority::kNormal;
+    std::unique_ptr<WorkerPool> pool;
+  };
+
+  uvcc::EventLoop *loop_;
+  Class classes_[4];
+
+  static std::size_t _index(const Request::TransmitType &type) {
+    switch (type) {
+      case Request::TransmitType::kFS:
+        return 0;
+      case Request::TransmitType::kWork:
+        return 1;
+      case Request::TransmitType::kGetAddrInfo:
+        return 2;
+      case Request::TransmitType::kRandom:
+        return 3;
+      default:
+        uvcc::expr_throws(UV_EINVAL);
+        return 0;
+    }
+  }
+
+  /// `getaddrinfo` runs outside libuv here, so map its errors the way
+  /// `uv_getaddrinfo` reports them.
+  static int _translate(int err) _NOEXCEPT {
+    switch (err) {
+      case 0:
+        return 0;
+#if defined(EAI_ADDRFAMILY)
+      case EAI_ADDRFAMILY:
+        return UV_EAI_ADDRFAMILY;
+#endif
+      case EAI_AGAIN:
+        return UV_EAI_AGAIN;
+      case EAI_BADFLAGS:
+        return UV_EAI_BADFLAGS;
+      case EAI_FAIL:
+        return UV_EAI_FAIL;
+      case EAI_FAMILY:
+        return UV_EAI_FAMILY;
+      case EAI_MEMORY:
+        return UV_EAI_MEMORY;
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+      case EAI_NODATA:
+        return UV_EAI_NODATA;
+#endif
+      case EAI_NONAME:
+        return UV_EAI_NONAME;
+      case EAI_SERVICE:
+        return UV_EAI_SERVICE;
+      case EAI_SOCKTYPE:
+        return UV_EAI_SOCKTYPE;
+      case EAI_SYSTEM:
+        return -errno;
+      default:
+        return UV_EAI_FAIL;
+    }
+  }
+
+  static int _niceness(const Priority &priority) _NOEXCEPT {
+    switch (priority) {
+      case Priority::kHigh:
+        return -5;
+      case Priority::kLow:
+        return 10;
+      default:
+        return 0;
+    }
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // WORKERPOOL_H
@@ -0,0 +1,196 @@
+/// MIT License
+///
+/// uvcc/write-coalescer.h
+/// uvcc
+///
+/// created by varrtix on 2026/10/19.
+/// Copyright (c) 2021 varrtix. All rights reserved.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to
+/// deal in the Software without restriction, including without limitation the
+/// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+/// sell copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+
+
+#ifndef WRITECOALESCER_H
+#define WRITECOALESCER_H
+
+#include <uv.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "tracer.h"
+#include "utilities.h"
+
+namespace uvcc {
+
+/// Loop-wide flusher for corked streams. Writes issued on a corked stream
+/// are appended to its `Batch`; every batch touched during an iteration is
+/// submitted as a single vectored `uv_write` from the prepare phase (writes
+/// issued by timers, idle or check callbacks) or the check phase (writes
+/// issued by I/O callbacks), so nothing waits longer than the iteration.
+class WriteCoalescer {
+ public:
+  using WritingRawCompletionBlock = uvcc::RawCompletionBlock<uv_write_cb>;
+  using WritingCompletionBlock = std::function<WritingRawCompletionBlock>;
+
+  struct Batch {
+    explicit Batch(uv_stream_t *stream) _NOEXCEPT : stream(stream) {}
+
+    uv_stream_t *stream;
+    std::vector<uv_buf_t> bufs;
+    std::vector<WritingCompletionBlock> blocks;
+    bool queued = false;
+  };
+
+  explicit WriteCoalescer(uv_loop_t *loop, uvcc::Tracer *tracer = nullptr)
+      : prepare_(new uv_prepare_t()), check_(new uv_check_t()),
+        tracer_(tracer) {
+    uv_prepare_init(loop, prepare_);
+    uv_check_init(loop, check_);
+    prepare_->data = check_->data = this;
+  }
+  WriteCoalescer(const WriteCoalescer &) = delete;
+  WriteCoalescer &operator=(const WriteCoalescer &) = delete;
+  ~WriteCoalescer() {
+    flush();
+    uv_close(reinterpret_cast<uv_handle_t *>(prepare_),
+             [](uv_handle_t *handle) {
+               delete reinterpret_cast<uv_prepare_t *>(handle);
+             });
+    uv_close(reinterpret_cast<uv_handle_t *>(check_), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_check_t *>(handle);
+    });
+  }
+
+  void enqueue(Batch &batch, const uv_buf_t *bufs, unsigned int count,
+               WritingCompletionBlock &&block) {
+    batch.bufs.insert(batch.bufs.end(), bufs, bufs + count);
+    batch.blocks.push_back(std::move(block));
+    if (batch.queued) return;
+    batch.queued = true;
+    dirty_.push_back(&batch);
+    if (!uv_is_active(reinterpret_cast<uv_handle_t *>(prepare_))) {
+      uv_prepare_start(prepare_, [](uv_prepare_t *handle) {
+        static_cast<WriteCoalescer *>(handle->data)->flush();
+      });
+      uv_check_start(check_, [](uv_check_t *handle) {
+        static_cast<WriteCoalescer *>(handle->data)->flush();
+      });
+    }
+  }
+
+  /// Submits `batch` now and forgets about it. Its entry is cleared
+  /// rather than erased, as a flush may be walking the list.
+  void remove(Batch &batch) _NOEXCEPT {
+    if (!batch.queued) return;
+    _submit(batch);
+    std::replace(dirty_.begin(), dirty_.end(), &batch,
+                 static_cast<Batch *>(nullptr));
+    if (flushing_)
+      std::replace(flushing_->begin(), flushing_->end(), &batch,
+                   static_cast<Batch *>(nullptr));
+  }
+
+  /// Blocks run by a failed submit may enqueue on other batches or destroy
+  /// their streams, so the flush walks a detached list; batches enqueued
+  /// meanwhile wait for the next prepare or check phase.
+  void flush() _NOEXCEPT {
+    std::vector<Batch *> dirty;
+    dirty.swap(dirty_);
+    auto flushing = flushing_;
+    flushing_ = &dirty;
+    for (std::size_t i = 0; i < dirty.size(); ++i)
+      if (dirty[i]) _submit(*dirty[i]);
+    flushing_ = flushing;
+    if (!dirty_.empty()) return;
+    uv_prepare_stop(prepare_);
+    uv_check_stop(check_);
+  }
+
+  void setTracer(uvcc::Tracer *tracer) _NOEXCEPT { tracer_ = tracer; }
+
+  /// Stand-in given to blocks whose write never reached libuv, so they
+  /// always get a request: only `type` and `handle` are set.
+  static uv_write_t unsubmitted(uv_stream_t *stream) _NOEXCEPT {
+    uv_write_t request = uv_write_t();
+    request.type = UV_WRITE;
+    request.handle = stream;
+    return request;
+  }
+
+  /// Writes `bufs` with one request whose completion fans out to `blocks`.
+  /// On failure nothing is submitted and `blocks` is left untouched.
+  static int submit(uv_stream_t *stream, const uv_buf_t *bufs,
+                    unsigned int count,
+                    std::vector<WritingCompletionBlock> &blocks,
+                    uvcc::Tracer *tracer = nullptr) _NOEXCEPT {
+    auto request = new WriteRequest();
+    request->blocks.swap(blocks);
+    request->tracer = tracer;
+    auto err = uv_write(&request->request, stream, bufs, count,
+                        [](uv_write_t *request, int status) {
+                          auto context =
+                              reinterpret_cast<WriteRequest *>(request);
+                          if (context->tracer)
+                            context->tracer->requestCompleted(request,
+                                                              UV_WRITE);
+                          for (auto &block : context->blocks)
+                            if (block) block(request, status);
+                          delete context;
+                        });
+    if (err) {
+      request->blocks.swap(blocks);
+      delete request;
+    } else if (tracer) {
+      tracer->requestSubmitted(&request->request, UV_WRITE);
+    }
+    return err;
+  }
+
+ private:
+  struct WriteRequest
+      : AllocationTracker::Tagged<AllocationTracker::Subsystem::kRequests> {
+    uv_write_t request;
+    std::vector<WritingCompletionBlock> blocks;
+    uvcc::Tracer *tracer;
+  };
+
+  uv_prepare_t *prepare_;
+  uv_check_t *check_;
+  uvcc::Tracer *tracer_;
+  std::vector<Batch *> dirty_;
+  std::vector<Batch *> *flushing_ = nullptr;
+
+  void _submit(Batch &batch) _NOEXCEPT {
+    batch.queued = false;
+    if (batch.bufs.empty()) return;
+    auto err = submit(batch.stream, batch.bufs.data(),
+                      static_cast<unsigned int>(batch.bufs.size()),
+                      batch.blocks, tracer_);
+    auto request = unsubmitted(batch.stream);
+    for (auto &block : batch.blocks)
+      if (block) block(&request, err);
+    batch.bufs.clear();
+    batch.blocks.clear();
+  }
+};
+
+}  // namespace uvcc
+
+#endif  // WRITECOALESCER_H
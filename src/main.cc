@@ -1,5 +1,6 @@
 #include <uvcc/event-loop.h>
 #include <uvcc/file-descriptor.h>
+#include <uvcc/handle-arena.h>
 #include <uvcc/network.h>
 #include <uvcc/request.h>
 #include <uvcc/stream.h>
@@ -33,6 +34,7 @@
 #define DEFAULT_BACKLOG 128
 
 uv_loop_t *loop;
+uvcc::HandleArena *arena;
 struct sockaddr_in addr;
 
 typedef struct {
@@ -51,11 +53,9 @@ void alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
   buf->len = suggested_size;
 }
 
-void on_close(uv_handle_t *handle) { free(handle); }
-
 void echo_write(uv_write_t *req, int status) {
   if (status) {
-    fprintf(stderr, "Write error %s\n", uv_strerror(status));
+    uvcc::expr_cerr(uvcc::Exception(status), req->handle->type);
   }
   free_write_req(req);
 }
@@ -68,8 +68,9 @@ void echo_read(uv_stream_t *client, ssize_t nread, const uv_buf_t *buf) {
     return;
   }
   if (nread < 0) {
-    if (nread != UV_EOF) fprintf(stderr, "Read error %s\n", uv_err_name(nread));
-    uv_close((uv_handle_t *)client, on_close);
+    if (nread != UV_EOF)
+      uvcc::expr_cerr(uvcc::Exception(static_cast<int>(nread)), client->type);
+    arena->release(client);
   }
 
   free(buf->base);
@@ -77,17 +78,17 @@ void echo_read(uv_stream_t *client, ssize_t nread, const uv_buf_t *buf) {
 
 void on_new_connection(uv_stream_t *server, int status) {
   if (status < 0) {
-    fprintf(stderr, "New connection error %s\n", uv_strerror(status));
+    uvcc::expr_cerr(uvcc::Exception(status), server->type);
     // error!
     return;
   }
 
-  uv_tcp_t *client = (uv_tcp_t *)malloc(sizeof(uv_tcp_t));
+  auto client = arena->acquire<uv_tcp_t>(UV_TCP);
   uv_tcp_init(loop, client);
   if (uv_accept(server, (uv_stream_t *)client) == 0) {
     uv_read_start((uv_stream_t *)client, alloc_buffer, echo_read);
   } else {
-    uv_close((uv_handle_t *)client, on_close);
+    arena->release(client);
   }
 }
 
@@ -97,6 +98,8 @@ int main() {
 
   loop = uv_default_loop();
   //    auto loop = uvcc::EventLoop::standard();
+  uvcc::HandleArena handles(loop);
+  arena = &handles;
 
   uv_tcp_t server;
   uv_tcp_init(loop, &server);
@@ -106,7 +109,7 @@ int main() {
   uv_tcp_bind(&server, (const struct sockaddr *)&addr, 0);
   int r = uv_listen((uv_stream_t *)&server, DEFAULT_BACKLOG, on_new_connection);
   if (r) {
-    fprintf(stderr, "Listen error %s\n", uv_strerror(r));
+    uvcc::expr_cerr(uvcc::Exception(r), UV_TCP);
     return 1;
   }
   return uv_run(loop, UV_RUN_DEFAULT);
@@ -0,0 +1,204 @@
+// Allocation tracker test: built with UVCC_TRACK_ALLOCATIONS, it checks that
+// each subsystem counts its allocations and live bytes, that live bytes
+// return to their baseline once storage is released, that frees from other
+// threads are charged to the allocating thread, that the peak never falls
+// below the live bytes under concurrent frees, and that recycling through
+// the pools and the handle arena allocates nothing once warm.
+//
+// usage: uvcc_allocation
+
+#include <uvcc/allocation-tracker.h>
+#include <uvcc/event-loop.h>
+#include <uvcc/pool.h>
+#include <uvcc/stream.h>
+#include <uvcc/typed-handle.h>
+#include <uvcc/typed-request.h>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Subsystem = uvcc::AllocationTracker::Subsystem;
+
+int failures = 0;
+
+void expect(bool condition, const char *what) {
+  if (condition) return;
+  ++failures;
+  std::printf("expected %s\n", what);
+}
+
+uvcc::AllocationTracker::Counters counters(Subsystem subsystem) {
+  return uvcc::AllocationTracker::current().counters(subsystem);
+}
+
+/// Checks that `block` allocates in `subsystem` and that its live bytes are
+/// back to where they started once `drain` has run.
+template <typename Block, typename Drain>
+void expectCounted(Subsystem subsystem, std::int64_t bytes, const char *what,
+                   Block &&block, Drain &&drain) {
+  auto before = counters(subsystem);
+  block();
+  auto during = counters(subsystem);
+  drain();
+  auto after = counters(subsystem);
+  if (during.allocations > before.allocations &&
+      during.live_bytes >= before.live_bytes + bytes &&
+      during.peak_bytes >= during.live_bytes &&
+      after.live_bytes == before.live_bytes)
+    return;
+  ++failures;
+  std::printf("expected %s to be counted (allocations %llu->%llu, live "
+              "%lld->%lld->%lld, peak %lld)\n",
+              what, static_cast<unsigned long long>(before.allocations),
+              static_cast<unsigned long long>(during.allocations),
+              static_cast<long long>(before.live_bytes),
+              static_cast<long long>(during.live_bytes),
+              static_cast<long long>(after.live_bytes),
+              static_cast<long long>(during.peak_bytes));
+}
+
+void subsystems(uvcc::EventLoop &loop) {
+  auto drain = [&] { loop.run(uvcc::RunOption::kDefault); };
+
+  std::unique_ptr<uvcc::TimerHandle> timer;
+  expectCounted(Subsystem::kHandles, sizeof(uv_timer_t), "handle storage",
+                [&] { timer.reset(new uvcc::TimerHandle(loop)); },
+                [&] {
+                  timer.reset();
+                  drain();
+                });
+
+  uvcc::WorkRequest work;
+  expectCounted(Subsystem::kRequests, sizeof(uv_work_t), "request storage",
+                [&] { work.queue(loop, [] {}, [](int) {}); }, drain);
+
+  std::unique_ptr<uvcc::Stream> stream;
+  expectCounted(Subsystem::kCallbacks, 1, "stream callback tables",
+                [&] {
+                  stream.reset(
+                      new uvcc::Stream(uvcc::Stream::TransmitType::kTCP));
+                  stream->open(loop);
+                },
+                [&] {
+                  stream.reset();
+                  drain();
+                });
+
+  std::unique_ptr<uvcc::BufferPool> pool;
+  expectCounted(Subsystem::kBuffers, 4096, "pooled buffers",
+                [&] {
+                  pool.reset(new uvcc::BufferPool(4096));
+                  pool->release(pool->acquire());
+                },
+                [&] { pool.reset(); });
+
+  void *other = nullptr;
+  expectCounted(Subsystem::kOther, 100, "direct allocations",
+                [&] {
+                  other = uvcc::AllocationTracker::allocate(Subsystem::kOther,
+                                                            100);
+                },
+                [&] { uvcc::AllocationTracker::deallocate(other); });
+
+  // libuv copies the host name with its own allocator.
+  uvcc::TypedRequest<uv_getaddrinfo_t> resolve;
+  expectCounted(Subsystem::kLibuv, 1, "libuv allocations",
+                [&] {
+                  resolve.resolve(loop, "127.0.0.1", nullptr, nullptr,
+                                  [](int, addrinfo *) {});
+                },
+                drain);
+
+  expect(&loop.allocations() == &uvcc::AllocationTracker::current(),
+         "the loop to report its thread's counters");
+  auto total = loop.allocations().total();
+  std::uint64_t allocations = 0;
+  for (int i = 0; i < uvcc::AllocationTracker::kSubsystemCount; ++i)
+    allocations += counters(static_cast<Subsystem>(i)).allocations;
+  expect(total.allocations == allocations, "the total to sum the subsystems");
+}
+
+/// After warm-up, recycling through the pools and the handle arena must
+/// not allocate at all.
+void steadyState(uvcc::EventLoop &loop) {
+  const int kIterations = 10000;
+  uvcc::BufferPool buffers(4096);
+  uvcc::RequestPool requests;
+  auto &arena = loop.arena();
+  auto cycle = [&](int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      buffers.release(buffers.acquire());
+      requests.release(requests.acquire());
+      arena.release(arena.acquire<uv_timer_t>(UV_TIMER));
+      // Released slots come back at the start of the next iteration.
+      loop.run(uvcc::RunOption::kNoWait);
+    }
+  };
+  cycle(1);
+  auto before = uvcc::AllocationTracker::current().total();
+  cycle(kIterations);
+  auto after = uvcc::AllocationTracker::current().total();
+  expect(after.allocations == before.allocations,
+         "no allocations on the recycling path");
+  expect(after.live_bytes == before.live_bytes, "no live bytes gained");
+}
+
+void threads() {
+  const int kBlocks = 4096;
+  const int kFreers = 4;
+  std::vector<void *> blocks;
+  const uvcc::AllocationTracker::Stats *owner = nullptr;
+  std::thread allocator([&] {
+    owner = &uvcc::AllocationTracker::current();
+    for (int i = 0; i < kBlocks; ++i)
+      blocks.push_back(
+          uvcc::AllocationTracker::allocate(Subsystem::kOther, 64));
+  });
+  allocator.join();
+  auto allocated = owner->counters(Subsystem::kOther);
+  expect(allocated.live_bytes == kBlocks * 64 &&
+             allocated.peak_bytes == kBlocks * 64,
+         "the allocating thread to own the bytes");
+
+  // Frees race each other on the owner's counters while this thread
+  // allocates and frees on its own.
+  auto before = counters(Subsystem::kOther);
+  std::vector<std::thread> freers;
+  for (int t = 0; t < kFreers; ++t)
+    freers.emplace_back([&, t] {
+      for (int i = t; i < kBlocks; i += kFreers)
+        uvcc::AllocationTracker::deallocate(blocks[i]);
+    });
+  for (int i = 0; i < kBlocks; ++i)
+    uvcc::AllocationTracker::deallocate(
+        uvcc::AllocationTracker::allocate(Subsystem::kOther, 64));
+  for (auto &freer : freers) freer.join();
+
+  auto freed = owner->counters(Subsystem::kOther);
+  expect(freed.live_bytes == 0, "frees charged to the allocating thread");
+  expect(freed.peak_bytes == kBlocks * 64, "the owner's peak to stay");
+  auto after = counters(Subsystem::kOther);
+  expect(after.live_bytes == before.live_bytes &&
+             after.peak_bytes >= before.live_bytes + 64 &&
+             after.allocations == before.allocations + kBlocks,
+         "this thread's own allocations only");
+}
+
+}  // namespace
+
+int main() {
+  // Must precede every other libuv call.
+  expect(uvcc::AllocationTracker::install(), "the allocator to install");
+  expect(uvcc::AllocationTracker::isInstalled(), "an installed allocator");
+  {
+    uvcc::EventLoop loop;
+    subsystems(loop);
+    steadyState(loop);
+  }
+  threads();
+  std::printf("allocation %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+// Connector test: staggers a second attempt past an address that never
+// answers, falls through a refused address without waiting out the delay,
+// and gives up with UV_ETIMEDOUT once the overall timeout elapses.
+//
+// The unanswered address is a loopback listener whose accept queue is full,
+// so the kernel drops further SYNs instead of refusing them.
+//
+// usage: uvcc_connector
+
+#include <uvcc/connector.h>
+#include <uvcc/event-loop.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int kFillers = 8;
+
+struct Result {
+  int status = 1;
+  bool connected = false;
+  std::size_t attempts = 0;
+  std::uint64_t elapsed = 0;
+  std::uint64_t drained = 0;
+};
+
+int failures = 0;
+
+void expect(bool condition, const char *name, const char *what,
+            const Result &result) {
+  if (condition) return;
+  ++failures;
+  std::printf("%s: expected %s (status=%d connected=%d attempts=%zu "
+              "elapsed=%llums)\n",
+              name, what, result.status, result.connected ? 1 : 0,
+              result.attempts,
+              static_cast<unsigned long long>(result.elapsed));
+}
+
+sockaddr_storage loopback(int fd) {
+  sockaddr_storage address{};
+  auto length = static_cast<socklen_t>(sizeof(address));
+  getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length);
+  return address;
+}
+
+/// Binds a loopback socket to an ephemeral port.
+int bound() {
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 ||
+      bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+    std::perror("bind");
+    std::exit(2);
+  }
+  return fd;
+}
+
+/// Addresses the test connects to; the sockets stay open for the whole run.
+struct Addresses {
+  sockaddr_storage accepting;
+  sockaddr_storage refused;
+  sockaddr_storage unanswered;
+  std::vector<int> fds;
+
+  Addresses() {
+    // The kernel completes handshakes on its own while the queue has room.
+    auto fd = bound();
+    listen(fd, 128);
+    accepting = loopback(fd);
+    fds.push_back(fd);
+
+    // Bound but not listening: connects are refused at once.
+    fd = bound();
+    refused = loopback(fd);
+    fds.push_back(fd);
+
+    // Never accepted, so the fillers keep the queue full.
+    fd = bound();
+    listen(fd, 0);
+    unanswered = loopback(fd);
+    fds.push_back(fd);
+    for (int i = 0; i < kFillers; ++i) {
+      auto filler = socket(AF_INET, SOCK_STREAM, 0);
+      fcntl(filler, F_SETFL, fcntl(filler, F_GETFL) | O_NONBLOCK);
+      connect(filler, reinterpret_cast<sockaddr *>(&unanswered),
+              sizeof(sockaddr_in));
+      fds.push_back(filler);
+    }
+    // Let the handshakes that fit settle into the accept queue.
+    usleep(50 * 1000);
+  }
+
+  ~Addresses() {
+    for (auto fd : fds) close(fd);
+  }
+};
+
+Result run(const std::vector<sockaddr_storage> &addresses,
+           const uvcc::network::Connector::Options &options) {
+  uvcc::EventLoop loop;
+  Result result;
+  auto started = uv_hrtime();
+  {
+    uvcc::network::Connector connector(loop, addresses, options);
+    connector.start(
+        [&](int status, const std::shared_ptr<uvcc::Stream> &stream) {
+          result.status = status;
+          result.connected = stream != nullptr;
+          result.elapsed = (uv_hrtime() - started) / 1000000;
+        });
+    loop.run(uvcc::RunOption::kDefault);
+    result.attempts = connector.attemptCount();
+  }
+  loop.run(uvcc::RunOption::kDefault);
+  result.drained = (uv_hrtime() - started) / 1000000;
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  Addresses addresses;
+  uvcc::network::Connector::Options options;
+
+  // A refused address starts the next attempt without waiting out the delay.
+  options.attempt_delay = 2000;
+  auto result = run({addresses.refused, addresses.accepting}, options);
+  expect(!result.status && result.connected, "fall-through", "connected",
+         result);
+  expect(result.attempts == 2, "fall-through", "two attempts", result);
+  expect(result.elapsed < 1000, "fall-through", "no stagger delay", result);
+  expect(result.drained < 1000, "fall-through",
+         "the cancelled delay to release the loop", result);
+
+  // An unanswered address holds the next attempt back by the delay only.
+  options.attempt_delay = 100;
+  result = run({addresses.unanswered, addresses.accepting}, options);
+  expect(!result.status && result.connected, "stagger", "connected", result);
+  expect(result.attempts == 2, "stagger", "two attempts", result);
+  expect(result.elapsed >= 90 && result.elapsed < 900, "stagger",
+         "the second attempt after the delay", result);
+
+  // Every address failing reports the last error.
+  result = run({addresses.refused, addresses.refused}, options);
+  expect(result.status == UV_ECONNREFUSED && !result.connected, "refused",
+         "UV_ECONNREFUSED", result);
+  expect(result.attempts == 2, "refused", "two attempts", result);
+
+  // Nothing answers before the overall timeout.
+  options.attempt_delay = 50;
+  options.timeout = 200;
+  result = run({addresses.unanswered, addresses.unanswered}, options);
+  expect(result.status == UV_ETIMEDOUT && !result.connected, "timeout",
+         "UV_ETIMEDOUT", result);
+  expect(result.attempts == 2, "timeout", "two attempts", result);
+  expect(result.elapsed >= 190 && result.elapsed < 900, "timeout",
+         "the timeout to elapse", result);
+
+  std::printf("connector %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
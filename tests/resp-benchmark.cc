@@ -0,0 +1,131 @@
+// RESP benchmark, built with UVCC_BENCHMARKS: times Scanner::findLineEnd
+// over long lines and Parser over a pipeline of commands under every
+// Scanner::Dispatch this CPU supports, and a large command fed in chunks
+// with and without Parser::Progress.
+//
+// usage: uvcc_resp_benchmark [rounds]
+
+#include <uvcc/resp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+using uvcc::resp::Command;
+using uvcc::resp::Parser;
+using uvcc::resp::Scanner;
+
+const char *name(Scanner::Dispatch dispatch) {
+  switch (dispatch) {
+    case Scanner::Dispatch::kSSE2:
+      return "sse2";
+    case Scanner::Dispatch::kAVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+std::string bulk(const std::string &value) {
+  return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+/// Commands shaped like a cache workload: short keys, mixed value sizes and
+/// some inline commands.
+std::string pipeline() {
+  std::string input;
+  for (int i = 0; i < 10000; ++i) {
+    auto key = "key:" + std::to_string(i);
+    if (i % 10 == 0) {
+      input += "GET " + key + "\r\n";
+    } else if (i % 2) {
+      input += "*2\r\n" + bulk("GET") + bulk(key);
+    } else {
+      input += "*3\r\n" + bulk("SET") + bulk(key) +
+               bulk(std::string(static_cast<std::size_t>(16 << (i % 7)), 'v'));
+    }
+  }
+  return input;
+}
+
+double seconds(std::uint64_t started) {
+  return static_cast<double>(uv_hrtime() - started) / 1e9;
+}
+
+void scan(int rounds) {
+  std::string line(4096, 'x');
+  line += "\r\n";
+  std::size_t found = 0;
+  auto started = uv_hrtime();
+  for (int i = 0; i < rounds * 1000; ++i) {
+    // Keeps the compiler from hoisting a pure memchr out of the loop.
+    asm volatile("" : : "g"(line.data()) : "memory");
+    found += Scanner::findLineEnd(line.data(), line.data() + line.size()) !=
+             nullptr;
+  }
+  auto elapsed = seconds(started);
+  std::printf("  scan   %8.0f MiB/s  (%zu lines)\n",
+              line.size() * rounds * 1000.0 / elapsed / (1 << 20), found);
+}
+
+void parse(const std::string &input, int rounds) {
+  Command command;
+  std::size_t commands = 0;
+  auto started = uv_hrtime();
+  for (int i = 0; i < rounds; ++i)
+    for (std::size_t offset = 0; offset < input.size();) {
+      auto consumed = Parser::parse(input.data() + offset,
+                                    input.size() - offset, Parser::Limits(),
+                                    command);
+      if (consumed <= 0) std::exit(1);
+      offset += static_cast<std::size_t>(consumed);
+      ++commands;
+    }
+  auto elapsed = seconds(started);
+  std::printf("  parse  %8.0f MiB/s  %8.2f Mcommands/s\n",
+              input.size() * rounds / elapsed / (1 << 20),
+              commands / elapsed / 1e6);
+}
+
+/// One command of many small arguments arriving 1 KiB at a time.
+void chunked(bool resumable) {
+  std::string input = "*100000\r\n";
+  for (int i = 0; i < 100000; ++i) input += bulk(std::to_string(i));
+  Command command;
+  Parser::Progress progress;
+  long consumed = 0;
+  auto started = uv_hrtime();
+  for (std::size_t size = 1024; !consumed; size += 1024) {
+    size = std::min(size, input.size());
+    consumed = resumable ? Parser::parse(input.data(), size, Parser::Limits(),
+                                         command, progress)
+                         : Parser::parse(input.data(), size, Parser::Limits(),
+                                         command);
+  }
+  std::printf("%-9s %8.3f s for %zu arguments in %zu reads\n",
+              resumable ? "resumed" : "reparsed", seconds(started),
+              command.size(), (input.size() + 1023) / 1024);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  auto rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  auto input = pipeline();
+  const Scanner::Dispatch dispatches[] = {
+      Scanner::Dispatch::kScalar, Scanner::Dispatch::kSSE2,
+      Scanner::Dispatch::kAVX2};
+  for (auto dispatch : dispatches) {
+    if (!Scanner::setDispatch(dispatch)) continue;
+    std::printf("%s\n", name(dispatch));
+    scan(rounds);
+    parse(input, rounds);
+  }
+  Scanner::setDispatch(Scanner::Dispatch::kScalar);
+  chunked(false);
+  chunked(true);
+  return 0;
+}
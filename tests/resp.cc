@@ -0,0 +1,180 @@
+// RESP parser test: pipelined, inline and partial commands, resuming an
+// incomplete array after the buffer has moved, the kMalformed and kTooLarge
+// cases, and every Scanner search this CPU supports against a plain loop.
+//
+// usage: uvcc_resp
+
+#include <uvcc/resp.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+using uvcc::resp::Command;
+using uvcc::resp::Parser;
+using uvcc::resp::Scanner;
+
+int failures = 0;
+
+void expect(bool condition, const char *what) {
+  if (condition) return;
+  ++failures;
+  std::printf("expected %s\n", what);
+}
+
+std::string join(const Command &command) {
+  std::string joined;
+  for (std::size_t i = 0; i < command.size(); ++i) {
+    if (i) joined += '|';
+    joined += command[i].toString();
+  }
+  return joined;
+}
+
+long parse(const std::string &input, Command &command,
+           const Parser::Limits &limits = Parser::Limits()) {
+  return Parser::parse(input.data(), input.size(), limits, command);
+}
+
+void pipelined() {
+  std::string input =
+      "*2\r\n$3\r\nGET\r\n$1\r\nk\r\n"
+      "*1\r\n$4\r\nPING\r\n"
+      "  SET  a\tb \r\n"
+      "\r\n"
+      "*-1\r\n"
+      "*0\r\n"
+      "*1\r\n$0\r\n\r\n";
+  const char *expected[] = {"GET|k", "PING", "SET|a|b", "", "", "", ""};
+  const bool inlined[] = {false, false, true, true, false, false, false};
+  Command command;
+  std::size_t offset = 0;
+  for (int i = 0; i < 7; ++i) {
+    auto consumed = Parser::parse(input.data() + offset, input.size() - offset,
+                                  Parser::Limits(), command);
+    expect(consumed > 0, "a pipelined command");
+    if (consumed <= 0) return;
+    expect(join(command) == expected[i], "the pipelined arguments");
+    expect(command.isInline() == inlined[i], "inline only for plain lines");
+    offset += static_cast<std::size_t>(consumed);
+  }
+  expect(offset == input.size(), "the whole pipeline consumed");
+  expect(command.size() == 1 && command[0].size() == 0, "an empty bulk");
+}
+
+void partial() {
+  std::string input = "*3\r\n$3\r\nSET\r\n$5\r\nhello\r\n$12\r\nwide\r\nvalue!\r\n";
+  Command command;
+  for (std::size_t size = 0; size < input.size(); ++size)
+    expect(Parser::parse(input.data(), size, Parser::Limits(), command) == 0,
+           "a prefix to need more input");
+  expect(parse(input, command) == static_cast<long>(input.size()),
+         "the complete command");
+  expect(join(command) == "SET|hello|wide\r\nvalue!", "a bulk holding CRLF");
+
+  // Every prefix again, each from a fresh copy so the buffer moves between
+  // calls, then once more in place.
+  Parser::Progress progress;
+  std::vector<std::string> copies;
+  copies.reserve(input.size() + 1);
+  long consumed = 0;
+  for (std::size_t size = 0; size <= input.size(); ++size) {
+    copies.emplace_back(input, 0, size);
+    consumed = Parser::parse(copies.back().data(), size, Parser::Limits(),
+                             command, progress);
+    if (size < input.size()) expect(consumed == 0, "a resumable prefix");
+  }
+  expect(consumed == static_cast<long>(input.size()), "a resumed command");
+  expect(join(command) == "SET|hello|wide\r\nvalue!", "resumed arguments");
+  expect(!progress.count, "the progress reset after a command");
+
+  for (std::size_t size = 0; size <= input.size(); ++size)
+    consumed = Parser::parse(input.data(), size, Parser::Limits(), command,
+                             progress);
+  expect(consumed == static_cast<long>(input.size()) &&
+             join(command) == "SET|hello|wide\r\nvalue!",
+         "a command resumed in place");
+
+  Parser::parse(input.data(), 13, Parser::Limits(), command, progress);
+  std::string bad = input.substr(0, 13) + "!5\r\nhello\r\n";
+  expect(Parser::parse(bad.data(), bad.size(), Parser::Limits(), command,
+                       progress) == Parser::kMalformed,
+         "an error after resuming");
+  expect(!progress.count, "the progress reset after an error");
+}
+
+void malformed() {
+  const char *inputs[] = {
+      "*2\r\n$3\r\nGET\r\n:1\r\n",   // not a bulk
+      "*1\r\n$3\r\nGETX\r\n",        // bulk longer than its header
+      "*x\r\n",                      // count not a number
+      "*1\r\n$-1\r\n",               // null bulk as an argument
+      "*1\r\n$\r\n",                 // empty length
+      "*123456789012345678901234",   // header line never ends
+      "*1234567890123456789\r\n",    // count too wide
+  };
+  Command command;
+  for (auto input : inputs)
+    expect(parse(input, command) == Parser::kMalformed, input);
+}
+
+void tooLarge() {
+  Parser::Limits limits;
+  limits.max_arguments = 2;
+  limits.max_bulk_bytes = 4;
+  limits.max_inline_bytes = 8;
+  Command command;
+  expect(parse("*3\r\n", command, limits) == Parser::kTooLarge,
+         "too many arguments");
+  expect(parse("*1\r\n$5\r\n", command, limits) == Parser::kTooLarge,
+         "a bulk over the limit");
+  expect(parse("GET aaaaaa\r\n", command, limits) == Parser::kTooLarge,
+         "an inline line over the limit");
+  expect(parse("GET aaaaaa", command, limits) == Parser::kTooLarge,
+         "an unterminated inline line over the limit");
+  expect(parse("GET a\r\n", command, limits) == 7, "an inline line in bounds");
+}
+
+const char *naive(const char *begin, const char *end) {
+  for (auto p = begin; p + 1 < end; ++p)
+    if (p[0] == '\r' && p[1] == '\n') return p;
+  return nullptr;
+}
+
+void scanner() {
+  const Scanner::Dispatch dispatches[] = {
+      Scanner::Dispatch::kScalar, Scanner::Dispatch::kSSE2,
+      Scanner::Dispatch::kAVX2};
+  expect(Scanner::dispatch() == Scanner::Dispatch::kScalar,
+         "memchr by default");
+  for (auto dispatch : dispatches) {
+    if (!Scanner::setDispatch(dispatch)) continue;
+    auto agrees = true;
+    for (std::size_t length = 0; length < 100 && agrees; ++length)
+      for (std::size_t at = 0; at <= length && agrees; ++at) {
+        std::string line(length, 'x');
+        // A lone CR first, so the search has to continue past it.
+        if (at > 1) line[at / 2] = '\r';
+        if (at < length) line[at] = '\r';
+        if (at + 1 < length) line[at + 1] = '\n';
+        auto begin = line.data(), end = line.data() + line.size();
+        agrees = Scanner::findLineEnd(begin, end) == naive(begin, end);
+      }
+    expect(agrees, "each search to match a plain loop");
+  }
+  Scanner::setDispatch(Scanner::Dispatch::kScalar);
+}
+
+}  // namespace
+
+int main() {
+  pipelined();
+  partial();
+  malformed();
+  tooLarge();
+  scanner();
+  std::printf("resp %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
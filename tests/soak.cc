@@ -0,0 +1,142 @@
+// Connection-churn soak test: opens and closes loopback connections through
+// Listener and Stream, and fails if RSS, descriptors or live handles grow
+// past the allowance after warm-up.
+//
+// usage: uvcc_soak [connections] [rss allowance in MiB]
+
+#include <uvcc/event-loop.h>
+#include <uvcc/network.h>
+#include <uvcc/resource-sampler.h>
+#include <uvcc/stream.h>
+#include <uvcc/typed-handle.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+namespace {
+
+const int kWarmUp = 1000;
+const int kParallel = 64;
+
+struct Soak {
+  uvcc::EventLoop loop;
+  uvcc::network::Listener listener{
+      uvcc::network::Parameters(),
+      uvcc::network::Endpoint(uvcc::network::Endpoint::IPv4Address::loopback(),
+                              static_cast<std::uint16_t>(0))};
+  std::unique_ptr<uvcc::ResourceSampler> sampler;
+  sockaddr_in address;
+  int target = kWarmUp;
+  int started = 0;
+  int finished = 0;
+  int failed = 0;
+
+  void churn() {
+    if (started >= target) return;
+    ++started;
+    auto client =
+        std::make_shared<uvcc::Stream>(uvcc::Stream::TransmitType::kTCP);
+    client->open(loop);
+    client->connect(reinterpret_cast<const sockaddr *>(&address),
+                    [this, client](uv_connect_t *, int status) mutable {
+                      if (status) return done(client, status);
+                      auto buf = uv_buf_init(const_cast<char *>("x"), 1);
+                      client->write(buf, [this, client](uv_write_t *,
+                                                        int status) mutable {
+                        done(client, status);
+                      });
+                    });
+  }
+
+  void done(std::shared_ptr<uvcc::Stream> &client, int status) {
+    if (status) ++failed;
+    client.reset();
+    ++finished;
+    churn();
+  }
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  auto connections = argc > 1 ? std::atoi(argv[1]) : 100000;
+  auto allowance = argc > 2 ? std::atoi(argv[2]) : 16;
+
+  Soak soak;
+  soak.listener.setBacklog(1024);
+  soak.listener.newConnectionHandler = uvcc::make_unique<
+      std::function<void(const uvcc::network::Connection &)>>(
+      [](const uvcc::network::Connection &connection) {
+        auto stream = connection.sharedStream();
+        stream->startReading(
+            [](uv_handle_t *, std::size_t, uv_buf_t *buf) {
+              static char storage[256];
+              *buf = uv_buf_init(storage, sizeof(storage));
+            },
+            [stream](uv_stream_t *, ssize_t nread, const uv_buf_t *) mutable {
+              if (nread >= 0) return;
+              stream->stopReading();
+              stream.reset();
+            });
+      });
+  soak.listener.start(soak.loop);
+  uv_ip4_addr("127.0.0.1", soak.listener.port(), &soak.address);
+
+  soak.sampler = uvcc::make_unique<uvcc::ResourceSampler>(soak.loop, 1000);
+  soak.sampler->sampleHandler = [&soak](
+                                    const uvcc::ResourceSampler::Sample &sample) {
+    std::printf("t=%llu rss=%zuKiB fds=%zu handles=%zu finished=%d\n",
+                static_cast<unsigned long long>(sample.time), sample.rss >> 10,
+                sample.fds, sample.handles, soak.finished);
+  };
+  soak.sampler->sample();
+  for (int i = 0; i < kParallel; ++i) soak.churn();
+
+  // Each phase ends once every connection is closed on both ends: the
+  // baseline is taken after warm-up, the final sample after the run.
+  uvcc::ResourceSampler::Sample sample;
+  auto settled = false;
+  uvcc::TimerHandle settle(soak.loop);
+  settle.start(100, 100, [&] {
+    if (soak.finished < soak.target) return;
+    if (!settled) {
+      settled = true;
+      return;
+    }
+    settled = false;
+    if (soak.target == kWarmUp) {
+      soak.sampler->resetBaseline();
+      soak.sampler->sample();
+      soak.target += connections;
+      for (int i = 0; i < kParallel; ++i) soak.churn();
+      return;
+    }
+    sample = soak.sampler->sample();
+    settle.stop();
+    soak.listener.cancel();
+    // Leaked handles would otherwise keep the loop running.
+    soak.loop.stop();
+  });
+  soak.loop.run(uvcc::RunOption::kDefault);
+
+  auto baseline = soak.sampler->baseline();
+  uvcc::ResourceSampler::Thresholds thresholds;
+  thresholds.rss = static_cast<std::size_t>(allowance) << 20;
+  thresholds.fds = 8;
+  thresholds.handles = 8;
+  auto grew = soak.sampler->exceeds(thresholds);
+  std::printf(
+      "connections=%d failed=%d rss=%zuKiB(+%lldKiB) fds=%zu(%+lld) "
+      "handles=%zu(%+lld) %s\n",
+      soak.finished, soak.failed, sample.rss >> 10,
+      (static_cast<long long>(sample.rss) -
+       static_cast<long long>(baseline.rss)) >> 10,
+      sample.fds,
+      static_cast<long long>(sample.fds) - static_cast<long long>(baseline.fds),
+      sample.handles,
+      static_cast<long long>(sample.handles) -
+          static_cast<long long>(baseline.handles),
+      grew ? "FAILED" : "ok");
+  return grew || soak.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
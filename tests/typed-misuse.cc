@@ -0,0 +1,30 @@
+// Compile-fail cases for the typed wrappers: each UVCC_MISUSE_* definition
+// enables one call that the handle or request type does not declare, and
+// the matching test passes only if the build fails. Without a definition
+// the file must build, which keeps unrelated errors from passing.
+
+#include <uvcc/event-loop.h>
+#include <uvcc/typed-handle.h>
+#include <uvcc/typed-request.h>
+
+int main() {
+  uvcc::EventLoop loop;
+  uvcc::TimerHandle timer(loop);
+  uvcc::TCPHandle tcp(loop);
+  uvcc::TypedRequest<uv_connect_t> connect;
+#if defined(UVCC_MISUSE_TIMER_READ)
+  // Timers are not streams.
+  timer.stopReading();
+#elif defined(UVCC_MISUSE_TCP_SEND)
+  // Only async handles can be woken from another thread.
+  tcp.send();
+#elif defined(UVCC_MISUSE_CONNECT_CANCEL)
+  // libuv cannot cancel a connect request.
+  connect.cancel();
+#endif
+  (void)connect;
+  timer.close();
+  tcp.close();
+  loop.run(uvcc::RunOption::kDefault);
+  return 0;
+}
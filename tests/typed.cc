@@ -0,0 +1,309 @@
+// Typed handle and request test: instantiates every TypedHandle and
+// TypedRequest operation on a live loop, and checks that a closed or
+// moved-from wrapper throws UV_EINVAL instead of touching freed storage.
+//
+// typed-misuse.cc holds the calls that must not compile.
+//
+// usage: uvcc_typed
+
+#include <uvcc/event-loop.h>
+#include <uvcc/typed-handle.h>
+#include <uvcc/typed-request.h>
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char *what) {
+  if (condition) return;
+  ++failures;
+  std::printf("expected %s\n", what);
+}
+
+template <typename Block>
+void expectError(int code, const char *what, Block &&block) {
+  try {
+    block();
+  } catch (const uvcc::Exception &exception) {
+    if (exception.rawCode() == code) return;
+  }
+  ++failures;
+  std::printf("expected %s to fail with %s\n", what, uv_err_name(code));
+}
+
+void allocate(uv_handle_t *, std::size_t size, uv_buf_t *buf) {
+  *buf = uv_buf_init(static_cast<char *>(std::malloc(size)),
+                     static_cast<unsigned int>(size));
+}
+
+void watchers(uvcc::EventLoop &loop) {
+  static_assert(uvcc::TimerHandle::type() == UV_TIMER, "timer type");
+  static_assert(uvcc::TimerHandle::size() == sizeof(uv_timer_t), "size");
+  auto fired = 0;
+  uvcc::TimerHandle timer(loop);
+  timer.start(1, 1, [&] {
+    if (++fired < 3) return;
+    timer.setRepeat(0);
+    timer.again();
+    timer.stop();
+  });
+  expect(timer.isActive() && !timer.isClosing(), "an active timer");
+  timer.unreference();
+  expect(!timer.hasReference(), "an unreferenced timer");
+  timer.reference();
+
+  auto idled = false, prepared = false, checked = false;
+  uvcc::IdleHandle idle(loop);
+  uvcc::PrepareHandle prepare(loop);
+  uvcc::CheckHandle check(loop);
+  idle.start([&] {
+    idled = true;
+    idle.stop();
+  });
+  prepare.start([&] {
+    prepared = true;
+    prepare.stop();
+  });
+  check.start([&] {
+    checked = true;
+    check.stop();
+  });
+
+  auto sent = false;
+  uvcc::AsyncHandle async(loop);
+  async.onSend([&] {
+    sent = true;
+    async.close();
+  });
+  std::thread sender([&] { async.send(); });
+
+  auto signalled = 0;
+  uvcc::SignalHandle signal(loop);
+  signal.start(SIGUSR1, [&](int signum) {
+    signalled = signum;
+    signal.stop();
+  });
+  uv_kill(uv_os_getpid(), SIGUSR1);
+
+  int fds[2];
+  if (pipe(fds)) std::exit(2);
+  auto polled = 0;
+  uvcc::PollHandle poll(loop, fds[1]);
+  poll.start(UV_WRITABLE, [&](int status, int events) {
+    if (!status) polled = events;
+    poll.stop();
+  });
+
+  loop.run(uvcc::RunOption::kDefault);
+  sender.join();
+  close(fds[0]);
+  close(fds[1]);
+  expect(fired == 3, "the timer to repeat until stopped");
+  expect(idled && prepared && checked, "idle, prepare and check to run");
+  expect(sent, "the async callback");
+  expect(signalled == SIGUSR1, "SIGUSR1");
+  expect(polled & UV_WRITABLE, "a writable pipe");
+}
+
+void streams(uvcc::EventLoop &loop) {
+  auto name = "/tmp/uvcc-typed-" + std::to_string(uv_os_getpid());
+  unlink(name.c_str());
+  std::string received;
+  auto eof = false;
+  uvcc::PipeHandle server(loop);
+  uvcc::PipeHandle accepted(loop);
+  server.bind(name);
+  server.listen(1, [&](uv_stream_t *, int status) {
+    if (status) return;
+    server.accept(accepted);
+    accepted.startReading(
+        allocate, [&](uv_stream_t *, ssize_t nread, const uv_buf_t *buf) {
+          if (nread > 0) received.append(buf->base, nread);
+          std::free(buf->base);
+          if (nread < 0) {
+            eof = nread == UV_EOF;
+            accepted.stopReading();
+            accepted.close();
+            server.close();
+          }
+        });
+  });
+
+  auto written = 1, shut = 1;
+  uvcc::PipeHandle client(loop);
+  client.connect(name, [&](uv_connect_t *, int status) {
+    if (status) return;
+    auto buf = uv_buf_init(const_cast<char *>("ping"), 4);
+    client.write(&buf, 1, [&](uv_write_t *, int status) { written = status; });
+    expect(client.writeQueueSize() <= 4, "a bounded write queue");
+    client.shutdown([&](uv_shutdown_t *, int status) {
+      shut = status;
+      client.close();
+    });
+  });
+
+  auto refused = 0;
+  uvcc::TCPHandle tcp(loop);
+  sockaddr_in address{};
+  uv_ip4_addr("127.0.0.1", 1, &address);
+  tcp.setNoDelay(true);
+  tcp.connect(reinterpret_cast<const sockaddr *>(&address),
+              [&](uv_connect_t *, int status) { refused = status; });
+
+  int fds[2];
+  if (pipe(fds)) std::exit(2);
+  // The handle owns the write end from here on.
+  uvcc::TTYHandle tty(loop, fds[1]);
+  auto buf = uv_buf_init(const_cast<char *>("x"), 1);
+  expect(tty.tryWrite(&buf, 1) == 1, "a direct write");
+
+  loop.run(uvcc::RunOption::kDefault);
+  tty.close();
+  loop.run(uvcc::RunOption::kDefault);
+  close(fds[0]);
+  unlink(name.c_str());
+  expect(received == "ping" && eof, "ping then EOF");
+  expect(!written && !shut, "the write and shutdown to complete");
+  expect(refused == UV_ECONNREFUSED, "a refused connect");
+}
+
+void closed(uvcc::EventLoop &loop) {
+  uvcc::TimerHandle timer(loop);
+  timer.close();
+  expect(!timer.isActive() && timer.isClosing(), "a closed timer");
+  timer.stop();
+  timer.setRepeat(1);
+  timer.reference();
+  expectError(UV_EINVAL, "starting a closed timer",
+              [&] { timer.start(1, 0, [] {}); });
+  expectError(UV_EINVAL, "restarting a closed timer", [&] { timer.again(); });
+
+  uvcc::TCPHandle tcp(loop);
+  uvcc::TCPHandle moved(std::move(tcp));
+  sockaddr_in address{};
+  uv_ip4_addr("127.0.0.1", 0, &address);
+  expectError(UV_EINVAL, "binding a moved-from handle", [&] {
+    tcp.bind(reinterpret_cast<const sockaddr *>(&address));
+  });
+  expectError(UV_EINVAL, "listening on a moved-from handle",
+              [&] { tcp.listen(1, [](uv_stream_t *, int) {}); });
+  expectError(UV_EINVAL, "reading a moved-from handle", [&] {
+    tcp.startReading(allocate, [](uv_stream_t *, ssize_t, const uv_buf_t *) {});
+  });
+  expectError(UV_EINVAL, "accepting into a moved-from handle",
+              [&] { moved.accept(tcp); });
+  tcp.stopReading();
+  auto buf = uv_buf_init(const_cast<char *>("x"), 1);
+  expect(tcp.tryWrite(&buf, 1) == UV_EINVAL, "UV_EINVAL from tryWrite");
+  expect(tcp.writeQueueSize() == 0, "an empty write queue");
+  moved.bind(reinterpret_cast<const sockaddr *>(&address));
+
+  uvcc::PipeHandle source(loop), target(loop);
+  target = std::move(source);
+  expectError(UV_EINVAL, "binding a moved-from pipe",
+              [&] { source.bind("/tmp/uvcc-typed-unused"); });
+  uvcc::AsyncHandle async(loop);
+  async.close();
+  expectError(UV_EINVAL, "sending to a closed async handle",
+              [&] { async.send(); });
+  loop.run(uvcc::RunOption::kDefault);
+}
+
+void requests(uvcc::EventLoop &loop) {
+  static_assert(uvcc::WorkRequest::type() == UV_WORK, "work type");
+  auto worked = false;
+  auto after = 1;
+  uvcc::WorkRequest work;
+  work.setTimeout(5000);
+  work.queue(loop, [&] { worked = true; }, [&](int status) { after = status; });
+  expect(work.isPending(), "a pending request");
+  expectError(UV_EBUSY, "resubmitting a pending request",
+              [&] { work.queue(loop, [] {}, [](int) {}); });
+
+  auto resolved = 1;
+  uvcc::TypedRequest<uv_getaddrinfo_t> resolve;
+  resolve.resolve(loop, "127.0.0.1", "80", nullptr,
+                  [&](int status, addrinfo *) { resolved = status; });
+
+  ssize_t stat = 1;
+  uvcc::TypedRequest<uv_fs_t> fs;
+  fs.fs(loop,
+        [](uv_loop_t *loop, uv_fs_t *request, uv_fs_cb callback) {
+          return uv_fs_stat(loop, request, ".", callback);
+        },
+        [&](ssize_t result, uv_fs_t *) { stat = result; });
+
+  loop.run(uvcc::RunOption::kDefault);
+  expect(worked && !after, "the work and its completion");
+  expect(!resolved, "a numeric address to resolve");
+  expect(!stat, "a stat of the working directory");
+  expect(!work.isPending(), "a settled request");
+  expectError(UV_EINVAL, "cancelling a settled request",
+              [&] { work.cancel(); });
+}
+
+/// More sleeping work than the pool has threads, with a deadline well
+/// before any of it can finish: the queued items are cancelled and the
+/// running ones complete early, each once, with UV_ETIMEDOUT.
+void deadlines(uvcc::EventLoop &loop) {
+  const int kItems = 6;
+  const std::uint64_t kDeadline = 50;
+  std::atomic<bool> started[kItems], finished[kItems];
+  int statuses[kItems], completions[kItems] = {};
+  bool early[kItems] = {};
+  std::uint64_t elapsed[kItems] = {};
+  uvcc::WorkRequest works[kItems];
+  auto begun = uv_hrtime();
+  for (int i = 0; i < kItems; ++i) {
+    started[i] = finished[i] = false;
+    works[i].setTimeout(kDeadline);
+    works[i].queue(loop,
+                   [&, i] {
+                     started[i] = true;
+                     uv_sleep(300);
+                     finished[i] = true;
+                   },
+                   [&, i](int status) {
+                     statuses[i] = status;
+                     ++completions[i];
+                     early[i] = !finished[i];
+                     elapsed[i] = (uv_hrtime() - begun) / 1000000;
+                   });
+  }
+  loop.run(uvcc::RunOption::kDefault);
+
+  auto running = 0;
+  for (int i = 0; i < kItems; ++i) {
+    if (started[i]) ++running;
+    expect(statuses[i] == UV_ETIMEDOUT, "UV_ETIMEDOUT at the deadline");
+    expect(completions[i] == 1, "the late result to be discarded");
+    expect(early[i] && elapsed[i] < 250, "completion before the work ends");
+    expect(!works[i].isPending(), "a request settled by its deadline");
+  }
+  expect(running > 0 && running < kItems,
+         "both running and queued requests");
+}
+
+}  // namespace
+
+int main() {
+  uvcc::EventLoop loop;
+  watchers(loop);
+  streams(loop);
+  closed(loop);
+  requests(loop);
+  deadlines(loop);
+  std::printf("typed %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}